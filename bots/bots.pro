@@ -0,0 +1,24 @@
+TEMPLATE = lib
+CONFIG += plugin c++17
+CONFIG -= qt
+
+TARGET = callbot
+
+# An example house bot, load it with serverd --house-bot path/to/libcallbot.so=3
+# The game code comes along so a bot can search with TableState::make_action
+
+SERVER_DIR = ../server
+
+INCLUDEPATH += $$SERVER_DIR
+
+SOURCES += \
+    callbot.cpp \
+    $$SERVER_DIR/tablestate.cpp \
+    $$SERVER_DIR/cards.cpp \
+    $$SERVER_DIR/zobrist.cpp
+
+HEADERS += \
+    $$SERVER_DIR/botapi.hpp \
+    $$SERVER_DIR/tablestate.hpp \
+    $$SERVER_DIR/cards.hpp \
+    $$SERVER_DIR/zobrist.hpp
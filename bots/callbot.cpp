@@ -0,0 +1,35 @@
+#include "botapi.hpp"
+
+#include <cstdlib>
+
+// Checks when it can and calls anything up to a share of its stack, folds to more.
+// The config is that share in percent, 100 (the default) never folds
+class CallBot : public HouseBot {
+public:
+    explicit CallBot(const char *config) {
+        if (config && *config) max_call_percent = atoi(config);
+    }
+
+    void onHandStart(const BotView &view) override {
+        start_stack = view.get_stack(view.get_seat());
+    }
+
+    Action decide(const BotView &view, const BotBudget &) override {
+        const LegalActions &legal = view.get_legal_actions();
+        if (legal.can(CHECK)) return Action(CHECK, 0);
+        if (legal.can(CALL) && legal.call_amount * 100 <= start_stack * max_call_percent) return Action(CALL, 0);
+        return Action(FOLD, 0);
+    }
+
+private:
+    int max_call_percent = 100;
+    int start_stack = 0;
+};
+
+HOUSE_BOT_EXPORT int house_bot_api_version() {
+    return HOUSE_BOT_API_VERSION;
+}
+
+HOUSE_BOT_EXPORT HouseBot *create_house_bot(const char *config) {
+    return new CallBot(config);
+}
@@ -1,91 +1,218 @@
 #include "client.hpp"
+#include "wireprotocol.hpp"
 
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonValue>
-#include <QJsonArray>
 #include <QDebug>
 using namespace std;
 
 Client::Client(QObject *parent) : QObject(parent), clientSocket(new QTcpSocket(this)), clientLoggedIn(false) {
 
-    connect(clientSocket, &QTcpSocket::connected, this, &Client::connected);
-    connect(clientSocket, &QTcpSocket::disconnected, this, &Client::disconnected);
+    connect(clientSocket, &QTcpSocket::connected, this, &Client::onConnected);
+    connect(clientSocket, &QTcpSocket::disconnected, this, &Client::onDisconnected);
 
     connect(clientSocket, &QTcpSocket::readyRead, this, &Client::onReadyRead);
 
 #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
-    connect(clientSocket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), this, &Client::error);
+    connect(clientSocket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), this, &Client::onSocketError);
 #else
-    connect(clientSocket, &QAbstractSocket::errorOccurred, this, &Client::error);
+    connect(clientSocket, &QAbstractSocket::errorOccurred, this, &Client::onSocketError);
 #endif
 
-    connect(clientSocket, &QTcpSocket::disconnected, this, &Client::logout);
+    reconnectTimer.setSingleShot(true);
+    connect(&reconnectTimer, &QTimer::timeout, this, &Client::reconnect);
+
+    handlers.on<HelloMessage, &Client::onHello>();
+    handlers.on<ResumeAcceptMessage, &Client::onResumeAccept>();
+    handlers.on<ResumeRejectMessage, &Client::onResumeReject>();
+    handlers.on<JoinGameAcceptMessage, &Client::onJoinGameAccept>();
+    handlers.on<PlayerJoinedMessage, &Client::onPlayerJoined>();
+    handlers.on<PlayerLeftMessage, &Client::onPlayerLeft>();
+    handlers.on<GameStateMessage, &Client::onGameState>();
+    handlers.on<StateDeltaMessage, &Client::onStateDelta>();
+    handlers.on<DealHoleCardsMessage, &Client::onDealHoleCards>();
+    handlers.on<DealCommunityMessage, &Client::onDealCommunity>();
+    handlers.on<ActionLogMessage, &Client::onActionLog>();
+    handlers.on<PlayerActionMessage, &Client::onPlayerAction>();
+    handlers.on<ActionClockMessage, &Client::onActionClock>();
+    handlers.on<RoundEndMessage, &Client::onRoundEnd>();
+    handlers.on<RevealCardsMessage, &Client::onRevealCards>();
+    handlers.on<ErrorMessage, &Client::onError>();
 }
 
-void Client::login(const QString& username) {
+void Client::onConnected() {
+    sendHello();
+    if (!resuming) {
+        emit connected();
+        return;
+    }
+
+    // Take the seat back, the server replays what we missed after lastEventSeq and sends a fresh state
+    ResumeSessionMessage resume;
+    resume.resume_token = resumeToken;
+    resume.seq = quint32(lastEventSeq);
+    sendMessage(resume);
+}
 
-    if (clientSocket->state() == QAbstractSocket::ConnectedState) {
+void Client::onDisconnected() {
+    // A seated player gets the chance to resume instead of going back to the login screen
+    if (clientLoggedIn && !resumeToken.isEmpty()) {
+        if (!resuming) beginResume();
+        else if (!reconnectTimer.isActive()) reconnectTimer.start(RECONNECT_DELAY_MS << reconnectAttempts);
+        return;
+    }
+    logout();
+    emit disconnected();
+}
 
-        QDataStream clientStream(clientSocket);
-        clientStream.setVersion(CLIENT_VERSION);
+void Client::onSocketError(QAbstractSocket::SocketError socketError) {
+    if (resuming) {
+        // A failed attempt, try again later (or give up) rather than reporting it
+        if (!reconnectTimer.isActive()) reconnectTimer.start(RECONNECT_DELAY_MS << reconnectAttempts);
+        return;
+    }
+    // Losing the connection while seated is handled by resuming once the socket reports it is gone
+    if (clientLoggedIn && !resumeToken.isEmpty()) return;
+    emit error(socketError);
+}
 
-        QJsonObject message;
-        message["type"] = QStringLiteral("JOIN_GAME_REQUEST");
+void Client::beginResume() {
+    resuming = true;
+    reconnectAttempts = 0;
+    emit gameLogReceived(QStringLiteral("Connection lost, reconnecting..."));
+    reconnectTimer.start(RECONNECT_DELAY_MS);
+}
 
-        QJsonObject payload;
-        payload["username"] = username;
+void Client::reconnect() {
+    if (!resuming) return;
+    if (reconnectAttempts >= RECONNECT_ATTEMPTS) {
+        resuming = false;
+        resumeToken.clear();
+        logout();
+        emit disconnected();
+        return;
+    }
+    if (channel ? channel->isOpen() : clientSocket->state() != QAbstractSocket::UnconnectedState) return;
+    reconnectAttempts++;
+    if (channel) connectChannel();
+    else clientSocket->connectToHost(serverAddress, serverPort);
+}
 
-        message["payload"] = payload;
+bool Client::isConnected() const {
+    return channel ? channel->isConnected() : clientSocket->state() == QAbstractSocket::ConnectedState;
+}
 
-        clientStream << QJsonDocument(message).toJson();
+void Client::sendMessage(const AnyMessage &message) {
+    if (channel) {
+        if (!channel->isOpen()) return;
+        channelFrames.enqueue(WireProtocol::frame(WireProtocol::encode(message, wireVersion)));
+        flushChannel();
+        return;
     }
+    QDataStream clientStream(clientSocket);
+    clientStream.setVersion(CLIENT_VERSION);
+    clientStream << WireProtocol::encode(message, wireVersion);
 }
 
-void Client::set_playerID(int id) {
-    playerID = id;
+void Client::flushChannel() {
+    while (!channelFrames.isEmpty() && channel->writeFrame(channelFrames.head())) channelFrames.dequeue();
+    channel->flush();
 }
 
-void Client::logout() {
-    clientLoggedIn = false;
+void Client::sendHello() {
+    wireVersion = 0;
+    // Always JSON, the server answers with the version both sides will use
+    HelloMessage hello;
+    hello.binary_version = binaryProtocol ? WIRE_PROTOCOL_VERSION : 0;
+    sendMessage(hello);
 }
 
-void Client::makeAction(const QString& actionType, int raise_amt) {
+void Client::set_binary_protocol(bool enabled) {
+    binaryProtocol = enabled;
+}
 
-    QDataStream clientStream(clientSocket);
-    clientStream.setVersion(CLIENT_VERSION);
+void Client::login(const QString& username, int table_id) {
 
-    QJsonObject message;
-    message["type"] = QStringLiteral("PLAYER_ACTION");
+    if (isConnected()) {
 
-    QJsonObject payload;
-    payload["action"] = actionType;
-    payload["amount"] = raise_amt;
+        JoinGameRequestMessage request;
+        request.username = username;
+        request.table_id = table_id;
+        sendMessage(request);
+    }
+}
 
-    message["payload"] = payload;
+void Client::watchTable(int table_id) {
+    WatchTableMessage watch;
+    watch.table_id = table_id;
 
-    clientStream << QJsonDocument(message).toJson();
+    stateVersion = -1; // the server starts us off with a full GAME_STATE
+    watchedTableID = table_id;
+    sendMessage(watch);
 }
 
-void Client::requestState() {
-    QDataStream clientStream(clientSocket);
-    clientStream.setVersion(CLIENT_VERSION);
+void Client::stopWatching() {
+    watchedTableID = -1;
+    sendMessage(UnwatchTableMessage());
+}
 
-    QJsonObject message;
-    message["type"] = QStringLiteral("REQUEST_STATE");
-    QJsonObject payload;
-    message["payload"] = payload;
+void Client::set_playerID(int id) {
+    playerID = id;
+}
 
-    clientStream << QJsonDocument(message).toJson();
+void Client::logout() {
+    clientLoggedIn = false;
+    tableID = -1;
+}
+
+void Client::makeAction(const QString& actionType, int raise_amt) {
+
+    PlayerActionMessage action;
+    action.action = WireProtocol::action(actionType);
+    action.amount = raise_amt;
+    sendMessage(action);
+}
+
+void Client::requestState() {
+    sendMessage(RequestStateMessage());
 }
 
 void Client::disconnectFromHost() {
-    clientSocket->disconnectFromHost();
+    // Leaving on purpose, so do not try to resume
+    resumeToken.clear();
+    resuming = false;
+    reconnectTimer.stop();
+    if (channel) channel->close();
+    else clientSocket->disconnectFromHost();
 }
 void Client::connectToServer(const QHostAddress &address, quint16 port) {
+    serverAddress = address;
+    serverPort = port;
     clientSocket->connectToHost(address, port);
 }
 
+void Client::connectToLocalServer(const QString &path) {
+    localPath = path;
+    if (!channel) {
+        channel = new ShmChannel(this);
+        connect(channel, &ShmChannel::connected, this, &Client::onConnected);
+        connect(channel, &ShmChannel::readyRead, this, &Client::onChannelReadyRead);
+        connect(channel, &ShmChannel::writable, this, &Client::flushChannel);
+        connect(channel, &ShmChannel::disconnected, this, &Client::onDisconnected);
+    }
+    connectChannel();
+}
+
+void Client::connectChannel() {
+    // Frames queued for the last connection mean nothing to the next one
+    channelFrames.clear();
+    if (!channel->connectTo(localPath)) onSocketError(QAbstractSocket::ConnectionRefusedError);
+}
+
+void Client::playersReceived(const QVector<PlayerSeat> &players) {
+    for (const PlayerSeat &seat : players) {
+        emit playerStateReceived(seat.player_id, seat.username, seat.stack, seat.role);
+    }
+}
+
 void Client::onReadyRead() {
 
     QByteArray jsonData;
@@ -96,176 +223,156 @@ void Client::onReadyRead() {
         socketStream.startTransaction();
         socketStream >> jsonData;
         if (socketStream.commitTransaction()) {
-            QJsonParseError parseError;
-            const QJsonDocument jsonDoc = QJsonDocument::fromJson(jsonData, &parseError);
-            if (parseError.error == QJsonParseError::NoError) {
-                if (jsonDoc.isObject())
-                    jsonReceived(jsonDoc.object());
-            }
+            AnyMessage message;
+            if (WireProtocol::decode(jsonData, message))
+                messageReceived(message);
         } else break; // read failed, exit loop and wait for more data
     }
 }
 
-void Client::jsonReceived(const QJsonObject &doc) {
-
-    const QString type = doc.value(QLatin1String("type")).toString();
-    const QJsonObject payload = doc.value(QLatin1String("payload")).toObject();
-
-    if (type == QLatin1String("JOIN_GAME_ACCEPT")) {
-        if (clientLoggedIn) return; // already logged in
-
-        const int player_id = payload.value(QLatin1String("player_id")).toInt();
-        const QString username = payload.value(QLatin1String("username")).toString();
-
-        emit loggedIn(player_id, username);
-
-        requestState();
-        return;
-
-    } else if (type == QLatin1String("PLAYER_JOINED")) {
-
-        const int player_id = payload.value(QLatin1String("player_id")).toInt();
-        const QString username = payload.value(QLatin1String("username")).toString();
-
-        emit newClientJoined(username, player_id);
-        return;
-
-    } else if (type == QLatin1String("PLAYER_LEFT")) {
-
-        const int player_id = payload.value(QLatin1String("player_id")).toInt();
-        const QString username = payload.value(QLatin1String("username")).toString();
-
-        emit clientLeft(username, player_id);
-        return;
-
-    } else if (type == QLatin1String("GAME_STATE")) {
-
-        const QJsonArray players = payload.value(QLatin1String("players")).toArray();
-        for (const QJsonValue &playerVal : players) {
-            if (!playerVal.isObject()) continue;
-            QJsonObject playerObj = playerVal.toObject();
-
-            int player_id = playerObj.value(QLatin1String("player_id")).toInt();
-            QString username = playerObj.value(QLatin1String("username")).toString();
-            int stack = playerObj.value(QLatin1String("stack")).toInt();
-            QString role = playerObj.value(QLatin1String("role")).toString();
-
-            emit playerStateReceived(player_id, username, stack, role);
-        }
-
-        int game_no = payload.value(QLatin1String("game_no")).toInt();
-        int pot = payload.value(QLatin1String("pot")).toInt();
-        QJsonArray boardArray = payload.value(QLatin1String("board")).toArray();
-        QStringList board;
-        for (const QJsonValue &cardVal : boardArray) {
-            board.append(cardVal.toString());
-        }
-        int current_player_index = payload.value(QLatin1String("current_player")).toInt();
-
-        int to_call = payload.value(QLatin1String("to_call")).toInt();
-
-        // TODO: Update UI to show all these states
-        emit gameStateReceived(game_no, pot, board, current_player_index, to_call);
-        return;
-
-    } else if (type == QLatin1String("DEAL_HOLE_CARDS")) {
-
-        const QJsonArray cards = payload.value(QLatin1String("cards")).toArray();
-        QString hole_1 = cards[0].toString();
-        QString hole_2 = cards[1].toString();
-
-        // TODO: Update UI to display the hole cards for this specific client
-        emit holeCardsReceived(playerID, hole_1, hole_2);
-        return;
-
-    } else if (type == QLatin1String("DEAL_COMMUNITY")) {
+void Client::onChannelReadyRead() {
+    // Decoded straight out of the ring, which is only handed back once that is done
+    while (channel->hasFrame()) {
+        AnyMessage message;
+        const bool decoded = WireProtocol::decode(channel->peekFrame(), message);
+        channel->skipFrame();
+        if (decoded) messageReceived(message);
+    }
+}
 
-        const QString round = payload.value(QLatin1String("round")).toString();
-        const QJsonArray boardArray = payload.value(QLatin1String("board")).toArray();
-        QStringList board;
-        for (const QJsonValue &cardVal : boardArray) {
-            board.append(cardVal.toString());
-        }
+void Client::messageReceived(const AnyMessage &message) {
+    handlers.dispatch(this, message);
+}
 
-        emit boardReceived(board);
-        return;
+// Table events carry a sequence number, remember how far we got in case we have to resume
+void Client::eventReceived(quint32 seq) {
+    lastEventSeq = qMax(lastEventSeq, qint64(seq));
+}
 
-    } else if (type == QLatin1String("ACTION_LOG")) {
+void Client::onHello(const HelloMessage &message) {
+    wireVersion = message.binary_version;
+}
 
-        const QString message = payload.value(QLatin1String("message")).toString();
+void Client::onResumeAccept(const ResumeAcceptMessage &message) {
+    resuming = false;
+    reconnectAttempts = 0;
+    reconnectTimer.stop();
+    eventReceived(message.seq);
+    stateVersion = -1; // a full GAME_STATE follows the replayed events
+    emit gameLogReceived(QStringLiteral("Reconnected"));
+}
 
-        emit gameLogReceived(message);
-        return;
+void Client::onResumeReject(const ResumeRejectMessage &) {
+    resuming = false;
+    resumeToken.clear();
+    reconnectTimer.stop();
+    logout();
+    emit disconnected();
+}
 
-    } else if (type == QLatin1String("PLAYER_ACTION")) {
+void Client::onJoinGameAccept(const JoinGameAcceptMessage &message) {
+    if (clientLoggedIn) return; // already logged in
 
-        int player_id = payload.value(QLatin1String("player_id")).toInt();
-        const QString username = payload.value(QLatin1String("username")).toString();
-        const QString action = payload.value(QLatin1String("action")).toString();
-        int to_call = payload.value(QLatin1String("to_call")).toInt();
-        int raise_amt = payload.value(QLatin1String("raise_amt")).toInt();
+    tableID = message.table_id;
+    resumeToken = message.resume_token;
+    lastEventSeq = qint64(message.seq);
+    clientLoggedIn = true;
 
-        emit actionReceived(player_id, username, action, to_call, raise_amt);
-        return;
+    emit loggedIn(message.player_id, message.username);
 
-    } else if (type == QLatin1String("ROUND_END")) {
+    requestState();
+}
 
-        const QJsonArray winnersArray = payload.value(QLatin1String("winners")).toArray();
-        QList<pair<int,int>> winners;
-        for (const QJsonValue &winnerVal : winnersArray) {
-            if (!winnerVal.isObject()) continue;
-            QJsonObject winnerObj = winnerVal.toObject();
-            int winner_id = winnerObj.value(QLatin1String("winner_id")).toInt();
-            int payout = winnerObj.value(QLatin1String("payout")).toInt();
-            winners.append({winner_id, payout});
-        }
+void Client::onPlayerJoined(const PlayerJoinedMessage &message) {
+    eventReceived(message.seq);
+    emit newClientJoined(message.username, message.player_id);
+}
 
-        emit winnersReceived(winners);
-        return;
+void Client::onPlayerLeft(const PlayerLeftMessage &message) {
+    eventReceived(message.seq);
+    emit clientLeft(message.username, message.player_id);
+}
 
-    } else if (type == QLatin1String("REVEAL_CARDS")) {
+void Client::onGameState(const GameStateMessage &message) {
 
-        int player_id = payload.value(QLatin1String("player_id")).toInt();
-        QJsonArray cardsArray = payload.value(QLatin1String("cards")).toArray();
-        QString hole_1 = cardsArray[0].toString();
-        QString hole_2 = cardsArray[1].toString();
+    playersReceived(message.players);
 
-        emit holeCardsReceived(player_id, hole_1, hole_2);
+    stateVersion = qint64(message.version);
+    gameNo = message.game_no;
+    pot = message.pot;
+    board = message.board;
+    currentPlayer = message.current_player;
+    toCall = message.to_call;
 
-    } else if (type == QLatin1String("ERROR")) {
+    // TODO: Update UI to show all these states
+    emit gameStateReceived(gameNo, pot, board, currentPlayer, toCall);
+}
 
-        const QString message = payload.value(QLatin1String("message")).toString();
-        emit gameLogReceived(message);
+void Client::onStateDelta(const StateDeltaMessage &message) {
 
+    // Deltas only make sense on top of the previous version, resync from a full state on a gap
+    const qint64 version = qint64(message.version);
+    if (version <= stateVersion) return;
+    if (stateVersion < 0 || version != stateVersion + 1) {
         requestState();
         return;
-
     }
-}
-
-
-
-
-
-
-
-
-
-
-
-
-
+    stateVersion = version;
 
+    playersReceived(message.players);
 
+    if (message.game_no) gameNo = *message.game_no;
+    if (message.pot) pot = *message.pot;
+    if (message.current_player) currentPlayer = *message.current_player;
+    if (message.to_call) toCall = *message.to_call;
 
+    if (message.board_reset || !message.board_new.isEmpty()) {
+        if (message.board_reset) board.clear();
+        board.append(message.board_new);
+        emit boardReceived(board);
+    }
 
+    emit gameStateReceived(gameNo, pot, board, currentPlayer, toCall);
+}
 
+void Client::onDealHoleCards(const DealHoleCardsMessage &message) {
+    if (message.cards.size() < 2) return;
 
+    // TODO: Update UI to display the hole cards for this specific client
+    emit holeCardsReceived(playerID, message.cards[0], message.cards[1]);
+}
 
+void Client::onDealCommunity(const DealCommunityMessage &message) {
+    emit boardReceived(message.board);
+}
 
+void Client::onActionLog(const ActionLogMessage &message) {
+    emit gameLogReceived(message.message);
+}
 
+void Client::onPlayerAction(const PlayerActionMessage &message) {
+    eventReceived(message.seq);
+    emit actionReceived(message.player_id, message.username, WireProtocol::actionName(message.action), message.to_call, message.raise_amt);
+}
 
+void Client::onActionClock(const ActionClockMessage &message) {
+    emit actionClockReceived(message.player_id, message.remaining_ms, message.time_bank);
+}
 
+void Client::onRoundEnd(const RoundEndMessage &message) {
+    emit winnersReceived(message.winners);
+}
 
+void Client::onRevealCards(const RevealCardsMessage &message) {
+    eventReceived(message.seq);
+    if (message.cards.size() < 2) return;
+    emit holeCardsReceived(message.player_id, message.cards[0], message.cards[1]);
+}
 
+void Client::onError(const ErrorMessage &message) {
+    emit gameLogReceived(message.message);
+    emit serverError(message.message);
 
+    // Catch up in case the error left us out of step, there is no state to ask for without a table
+    if (tableID >= 0 || watchedTableID >= 0) requestState();
+}
@@ -2,10 +2,17 @@
 
 #include <vector>
 
-#include <QMainWindow>
+#include <QObject>
+#include <QDataStream>
 #include <QTcpSocket>
-#include <QJsonObject>
+#include <QHostAddress>
+#include <QTimer>
+#include <QQueue>
 #include <QString>
+#include <QStringList>
+
+#include "messages.hpp"
+#include "shmchannel.hpp"
 using namespace std;
 
 #define CLIENT_VERSION QDataStream::Version::Qt_5_7
@@ -14,6 +21,11 @@ using namespace std;
 
 #define SERVER_IP "127.0.0.1"
 
+// Reconnect attempts after a dropped connection, with the delay doubling from RECONNECT_DELAY_MS.
+// Together they cover the time the server holds the seat
+#define RECONNECT_ATTEMPTS 6
+#define RECONNECT_DELAY_MS 500
+
 class Client : public QObject
 {
     Q_OBJECT
@@ -22,14 +34,27 @@ public:
     explicit Client(QObject* parent = nullptr);
 public slots:
     void connectToServer(const QHostAddress &address, quint16 port);
-    void login(const QString &username);
+    // A server on this host started with a local socket, messages then go through shared memory
+    void connectToLocalServer(const QString &path);
+    void login(const QString &username, int table_id = -1);
+    // Receive a table's public state and events without taking a seat
+    void watchTable(int table_id);
+    void stopWatching();
     void set_playerID(int id);
     void logout();
     void makeAction(const QString &actionType, int raise_amt);
     void requestState();
     void disconnectFromHost();
+    void set_binary_protocol(bool enabled);
 private slots:
     void onReadyRead();
+    void onChannelReadyRead();
+    void flushChannel();
+    void sendHello();
+    void onConnected();
+    void onDisconnected();
+    void onSocketError(QAbstractSocket::SocketError socketError);
+    void reconnect();
 signals:
     void connected();
     void loggedIn(int player_id, const QString& username);
@@ -42,13 +67,65 @@ signals:
     void playerStateReceived(int player_id, const QString& username, int stack, const QString& role);
     void gameStateReceived(int game_no, int pot, const QStringList& board, int current_player_index, int to_call);
     void actionReceived(int sender_id, const QString& username, const QString &actionType, int to_call, int raise_amt);
+    void actionClockReceived(int player_id, int remaining_ms, bool time_bank);
     void boardReceived(const QStringList& board);
     void gameLogReceived(const QString& message);
+    void serverError(const QString& message);
     void winnersReceived(const QList<pair<int,int>>& winners);
     void holeCardsReceived(int player_id, const QString& hole_1, const QString& hole_2);
 private:
     QTcpSocket* clientSocket;
+    ShmChannel *channel = nullptr;   // used instead of clientSocket once connectToLocalServer is called
+    QString localPath;
+    QQueue<QByteArray> channelFrames; // frames waiting for room in the channel
     bool clientLoggedIn;
-    void jsonReceived(const QJsonObject &doc);
+    void messageReceived(const AnyMessage &message);
+    void connectChannel();
+    // Through whichever of the socket or the channel this client uses
+    bool isConnected() const;
+    void sendMessage(const AnyMessage &message);
+    void playersReceived(const QVector<PlayerSeat> &players);
+    void eventReceived(quint32 seq);
+
+    // Handlers for what the server sends, see handlers
+    void onHello(const HelloMessage &message);
+    void onResumeAccept(const ResumeAcceptMessage &message);
+    void onResumeReject(const ResumeRejectMessage &message);
+    void onJoinGameAccept(const JoinGameAcceptMessage &message);
+    void onPlayerJoined(const PlayerJoinedMessage &message);
+    void onPlayerLeft(const PlayerLeftMessage &message);
+    void onGameState(const GameStateMessage &message);
+    void onStateDelta(const StateDeltaMessage &message);
+    void onDealHoleCards(const DealHoleCardsMessage &message);
+    void onDealCommunity(const DealCommunityMessage &message);
+    void onActionLog(const ActionLogMessage &message);
+    void onPlayerAction(const PlayerActionMessage &message);
+    void onActionClock(const ActionClockMessage &message);
+    void onRoundEnd(const RoundEndMessage &message);
+    void onRevealCards(const RevealCardsMessage &message);
+    void onError(const ErrorMessage &message);
+    MessageDispatch<Client> handlers;
     int playerID = -1;
+    int tableID = -1;        // the table we are seated at
+    int watchedTableID = -1; // the table we are watching without a seat
+
+    // Resuming after a dropped connection
+    QHostAddress serverAddress;
+    quint16 serverPort = 0;
+    QString resumeToken;     // issued by the server when we join
+    qint64 lastEventSeq = 0; // last table event received, so the server knows what to replay
+    bool resuming = false;
+    int reconnectAttempts = 0;
+    QTimer reconnectTimer;
+    void beginResume();
+    bool binaryProtocol = true; // ask the server for the binary protocol on connect
+    int wireVersion = 0;        // version agreed by the server, 0 means JSON
+
+    // Last full state, kept up to date from STATE_DELTAs
+    qint64 stateVersion = -1;
+    int gameNo = 0;
+    int pot = 0;
+    QStringList board;
+    int currentPlayer = -1;
+    int toCall = 0;
 };
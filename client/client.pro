@@ -22,6 +22,11 @@ HEADERS += \
     mainwindow.hpp \
     client.hpp \
 
+INCLUDEPATH += ../shared
+
+SOURCES += ../shared/wireprotocol.cpp ../shared/messages.cpp ../shared/shmchannel.cpp
+HEADERS += ../shared/wireprotocol.hpp ../shared/messages.hpp ../shared/messageschema.hpp ../shared/shmchannel.hpp
+
 FORMS += \
     gamewindow.ui \
     loginwindow.ui \
@@ -0,0 +1,135 @@
+#include "bot.hpp"
+
+#include <cmath>
+
+Bot::Bot(const QString &new_username, const BotConfig &new_config, BotStats *new_stats, QObject *parent)
+    : QObject(parent)
+    , username(new_username)
+    , config(new_config)
+    , stats(new_stats)
+    , random(QRandomGenerator::global()->generate()) {
+
+    client.set_binary_protocol(config.binary);
+
+    connect(&client, &Client::connected, this, &Bot::onConnected);
+    connect(&client, &Client::loggedIn, this, &Bot::onLoggedIn);
+    connect(&client, &Client::gameStateReceived, this, &Bot::onGameState);
+    connect(&client, &Client::actionReceived, this, &Bot::onAction);
+    connect(&client, &Client::serverError, this, &Bot::onError);
+    connect(&client, &Client::disconnected, this, [this]() { stats->disconnected++; });
+
+    thinkTimer.setSingleShot(true);
+    connect(&thinkTimer, &QTimer::timeout, this, &Bot::act);
+    retryTimer.setSingleShot(true);
+    connect(&retryTimer, &QTimer::timeout, this, &Bot::act);
+    connect(&stateTimer, &QTimer::timeout, this, &Bot::requestState);
+}
+
+Bot::~Bot() {
+    // Leave for good rather than have the client try to resume while it is torn down
+    client.disconnect(this);
+    client.disconnectFromHost();
+}
+
+void Bot::start() {
+    if (!config.localPath.isEmpty()) client.connectToLocalServer(config.localPath);
+    else client.connectToServer(config.address, config.port);
+}
+
+void Bot::onConnected() {
+    stats->connected++;
+    client.login(username, config.tableId);
+}
+
+void Bot::onLoggedIn(int player_id, const QString &) {
+    playerID = player_id;
+    client.set_playerID(player_id);
+    stats->seated++;
+    if (config.stateRequestMs > 0) stateTimer.start(config.stateRequestMs);
+}
+
+void Bot::onGameState(int game_no, int, const QStringList &board, int current_player_index, int to_call) {
+
+    if (playerID < 0) return;
+    toCall = to_call;
+
+    if (current_player_index != playerID) {
+        turnPending = false;
+        thinkTimer.stop();
+        retryTimer.stop();
+        return;
+    }
+
+    // Play a turn once, a new round can hand the turn straight back to us without anyone else acting
+    if (turnPending && turnGame == game_no && turnBoardSize == board.size()) return;
+    turnPending = true;
+    turnGame = game_no;
+    turnBoardSize = board.size();
+    raiseRejected = false;
+    thinkTimer.start(thinkTime());
+}
+
+void Bot::act() {
+
+    if (!turnPending) return;
+
+    QString action;
+    int amount = 0;
+    const bool canRaise = !raiseRejected;
+    switch (config.policy) {
+    case POLICY_PASSIVE:
+        action = toCall == 0 ? QStringLiteral("CHECK") : QStringLiteral("CALL");
+        break;
+    case POLICY_RANDOM: {
+        const quint32 roll = random.bounded(100);
+        if (roll < 10 && toCall > 0) action = QStringLiteral("FOLD");
+        else if (roll < 30 && canRaise) action = QStringLiteral("RAISE");
+        else action = toCall == 0 ? QStringLiteral("CHECK") : QStringLiteral("CALL");
+        break;
+    }
+    case POLICY_AGGRESSIVE:
+        action = canRaise ? QStringLiteral("RAISE") : (toCall == 0 ? QStringLiteral("CHECK") : QStringLiteral("CALL"));
+        break;
+    }
+    if (action == QLatin1String("RAISE")) amount = qMax(toCall, config.raiseAmount);
+
+    client.makeAction(action, amount);
+    stats->actionsSent++;
+    sentAt.start();
+    retryTimer.start(config.retryMs);
+}
+
+void Bot::onAction(int sender_id, const QString &, const QString &, int, int) {
+    if (sender_id != playerID || !sentAt.isValid()) return;
+    stats->latenciesNs.append(sentAt.nsecsElapsed());
+    stats->actionsEchoed++;
+    sentAt.invalidate();
+    retryTimer.stop();
+}
+
+void Bot::onError(const QString &) {
+    // Our action was refused, fall back to calling. The client has already asked for a fresh state
+    if (!turnPending) return;
+    stats->errors++;
+    raiseRejected = true;
+    sentAt.invalidate();
+    retryTimer.stop();
+    thinkTimer.start(thinkTime());
+}
+
+void Bot::requestState() {
+    client.requestState();
+    stats->stateRequests++;
+}
+
+int Bot::thinkTime() {
+    switch (config.think) {
+    case THINK_FIXED:
+        return config.thinkMs;
+    case THINK_UNIFORM:
+        return int(random.bounded(2 * config.thinkMs + 1));
+    case THINK_EXPONENTIAL:
+        return int(-config.thinkMs * log(1.0 - random.generateDouble()));
+    }
+    return config.thinkMs;
+}
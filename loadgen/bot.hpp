@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QObject>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVector>
+#include <QRandomGenerator>
+
+#include "client.hpp"
+using namespace std;
+
+// How bots pick an action once it is their turn
+enum BotPolicy {
+    POLICY_PASSIVE,    // check or call
+    POLICY_RANDOM,     // mostly call, sometimes raise or fold
+    POLICY_AGGRESSIVE  // raise whenever it can
+};
+
+// How long bots wait before acting
+enum ThinkDistribution {
+    THINK_FIXED,
+    THINK_UNIFORM,     // between 0 and twice the mean
+    THINK_EXPONENTIAL
+};
+
+struct BotConfig {
+    QHostAddress address;
+    quint16 port;
+    QString localPath; // connect through shared memory at this socket path instead
+    int tableId = -1;  // -1 lets the server pick
+    BotPolicy policy = POLICY_PASSIVE;
+    ThinkDistribution think = THINK_EXPONENTIAL;
+    int thinkMs = 200;
+    int raiseAmount = 4;
+    int stateRequestMs = 0; // every bot sends REQUEST_STATE this often, 0 never
+    int retryMs = 1500;     // act again if our action was not echoed by then (the engine may not have been ready)
+    bool binary = true;
+};
+
+// What one swarm thread has measured, merged by the main thread at the end
+struct BotStats {
+    QVector<qint64> latenciesNs; // action sent to its PLAYER_ACTION echo
+    qint64 actionsSent = 0;
+    qint64 actionsEchoed = 0;
+    qint64 stateRequests = 0;
+    qint64 errors = 0;
+    int connected = 0;
+    int seated = 0;
+    int disconnected = 0;
+};
+
+// A headless player on the real client code, it plays whenever the state says it is its turn
+class Bot : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(Bot)
+public:
+    Bot(const QString &username, const BotConfig &config, BotStats *stats, QObject *parent = nullptr);
+    ~Bot();
+    void start();
+
+private slots:
+    void onConnected();
+    void onLoggedIn(int player_id, const QString &username);
+    void onGameState(int game_no, int pot, const QStringList &board, int current_player_index, int to_call);
+    void onAction(int sender_id, const QString &username, const QString &actionType, int to_call, int raise_amt);
+    void onError(const QString &message);
+    void act();
+    void requestState();
+
+private:
+    int thinkTime();
+
+    Client client;
+    QString username;
+    const BotConfig &config;
+    BotStats *stats;
+    QRandomGenerator random;
+
+    int playerID = -1;
+    int toCall = 0;
+    bool raiseRejected = false;
+
+    // The turn we last acted on, so that repeated states for the same turn do not act twice
+    bool turnPending = false;
+    int turnGame = -1;
+    int turnBoardSize = -1;
+
+    QTimer thinkTimer;
+    QTimer retryTimer;
+    QTimer stateTimer;
+    QElapsedTimer sentAt;
+};
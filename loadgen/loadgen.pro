@@ -0,0 +1,36 @@
+QT       += core network
+QT       -= gui
+
+TARGET = loadgen
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Headless bots for load testing a server, built on the same Client class as the GUI
+
+CLIENT_DIR = ../client
+
+INCLUDEPATH += $$CLIENT_DIR ../shared
+
+SOURCES += \
+    main.cpp \
+    bot.cpp \
+    swarm.cpp \
+    $$CLIENT_DIR/client.cpp \
+    ../shared/wireprotocol.cpp \
+    ../shared/messages.cpp \
+    ../shared/shmchannel.cpp
+
+HEADERS += \
+    bot.hpp \
+    swarm.hpp \
+    $$CLIENT_DIR/client.hpp \
+    ../shared/wireprotocol.hpp \
+    ../shared/messages.hpp \
+    ../shared/messageschema.hpp \
+    ../shared/shmchannel.hpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
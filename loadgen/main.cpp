@@ -0,0 +1,154 @@
+#include "swarm.hpp"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+// Nearest-rank percentile of sorted samples, in milliseconds
+double percentileMs(const QVector<qint64> &sorted, double percentile) {
+    if (sorted.isEmpty()) return 0;
+    int rank = int(percentile / 100.0 * sorted.size() + 0.999999);
+    rank = qBound(1, rank, int(sorted.size()));
+    return sorted[rank - 1] / 1e6;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("loadgen"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Plays a swarm of bots against a running server and reports action latency"));
+    parser.addHelpOption();
+    QCommandLineOption hostOption(QStringLiteral("host"), QStringLiteral("Server address."), QStringLiteral("address"), QStringLiteral(SERVER_IP));
+    QCommandLineOption portOption({QStringLiteral("p"), QStringLiteral("port")},
+                                  QStringLiteral("Server port."), QStringLiteral("port"), QString::number(SERVER_PORT));
+    QCommandLineOption botsOption({QStringLiteral("n"), QStringLiteral("bots")},
+                                  QStringLiteral("Number of connections."), QStringLiteral("count"), QStringLiteral("1000"));
+    QCommandLineOption threadsOption({QStringLiteral("t"), QStringLiteral("threads")},
+                                     QStringLiteral("Threads to spread the bots over, 0 for one per core."), QStringLiteral("count"), QStringLiteral("0"));
+    QCommandLineOption rateOption(QStringLiteral("connect-rate"),
+                                  QStringLiteral("New connections per second."), QStringLiteral("count"), QStringLiteral("500"));
+    QCommandLineOption durationOption({QStringLiteral("d"), QStringLiteral("duration")},
+                                      QStringLiteral("Seconds to run for."), QStringLiteral("seconds"), QStringLiteral("60"));
+    QCommandLineOption tableOption(QStringLiteral("table"),
+                                   QStringLiteral("Table to join, -1 lets the server fill tables in order."), QStringLiteral("id"), QStringLiteral("-1"));
+    QCommandLineOption policyOption(QStringLiteral("policy"),
+                                    QStringLiteral("How bots play: passive, random or aggressive."), QStringLiteral("policy"), QStringLiteral("random"));
+    QCommandLineOption thinkOption(QStringLiteral("think-ms"),
+                                   QStringLiteral("Mean think time before acting."), QStringLiteral("ms"), QStringLiteral("200"));
+    QCommandLineOption distOption(QStringLiteral("think-dist"),
+                                  QStringLiteral("Think time distribution: fixed, uniform or exponential."), QStringLiteral("distribution"), QStringLiteral("exponential"));
+    QCommandLineOption raiseOption(QStringLiteral("raise"),
+                                   QStringLiteral("Amount bots raise by."), QStringLiteral("amount"), QStringLiteral("4"));
+    QCommandLineOption stateOption(QStringLiteral("state-every"),
+                                   QStringLiteral("Milliseconds between REQUEST_STATEs from each bot, 0 for none."), QStringLiteral("ms"), QStringLiteral("0"));
+    QCommandLineOption localOption(QStringLiteral("local"),
+                                   QStringLiteral("Connect through shared memory to a server on this host started with --local, at this socket path."),
+                                   QStringLiteral("path"));
+    QCommandLineOption jsonOption(QStringLiteral("json"), QStringLiteral("Use the JSON protocol instead of the binary one."));
+    parser.addOption(hostOption);
+    parser.addOption(portOption);
+    parser.addOption(botsOption);
+    parser.addOption(threadsOption);
+    parser.addOption(rateOption);
+    parser.addOption(durationOption);
+    parser.addOption(tableOption);
+    parser.addOption(policyOption);
+    parser.addOption(thinkOption);
+    parser.addOption(distOption);
+    parser.addOption(raiseOption);
+    parser.addOption(stateOption);
+    parser.addOption(localOption);
+    parser.addOption(jsonOption);
+    parser.process(a);
+
+    bool ok = false;
+    BotConfig config;
+    if (!config.address.setAddress(parser.value(hostOption))) parser.showHelp(1);
+    config.port = parser.value(portOption).toUShort(&ok);
+    if (!ok) parser.showHelp(1);
+    config.tableId = parser.value(tableOption).toInt(&ok);
+    if (!ok) parser.showHelp(1);
+    config.thinkMs = parser.value(thinkOption).toInt(&ok);
+    if (!ok || config.thinkMs < 0) parser.showHelp(1);
+    config.raiseAmount = parser.value(raiseOption).toInt(&ok);
+    if (!ok || config.raiseAmount < 1) parser.showHelp(1);
+    config.stateRequestMs = parser.value(stateOption).toInt(&ok);
+    if (!ok || config.stateRequestMs < 0) parser.showHelp(1);
+    config.binary = !parser.isSet(jsonOption);
+    config.localPath = parser.value(localOption);
+
+    const QStringList policies = {QStringLiteral("passive"), QStringLiteral("random"), QStringLiteral("aggressive")};
+    const int policy = policies.indexOf(parser.value(policyOption).toLower());
+    if (policy < 0) parser.showHelp(1);
+    config.policy = BotPolicy(policy);
+
+    const QStringList distributions = {QStringLiteral("fixed"), QStringLiteral("uniform"), QStringLiteral("exponential")};
+    const int distribution = distributions.indexOf(parser.value(distOption).toLower());
+    if (distribution < 0) parser.showHelp(1);
+    config.think = ThinkDistribution(distribution);
+
+    const int numBots = parser.value(botsOption).toInt(&ok);
+    if (!ok || numBots < 1) parser.showHelp(1);
+    int numThreads = parser.value(threadsOption).toInt(&ok);
+    if (!ok || numThreads < 0) parser.showHelp(1);
+    if (numThreads == 0) numThreads = qMax(1, QThread::idealThreadCount());
+    numThreads = qMin(numThreads, numBots);
+    const int connectRate = parser.value(rateOption).toInt(&ok);
+    if (!ok || connectRate < 1) parser.showHelp(1);
+    const int duration = parser.value(durationOption).toInt(&ok);
+    if (!ok || duration < 1) parser.showHelp(1);
+
+    QVector<Swarm*> swarms;
+    for (int i = 0; i < numThreads; ++i) {
+        const int share = numBots / numThreads + (i < numBots % numThreads ? 1 : 0);
+        Swarm *swarm = new Swarm(QStringLiteral("bot%1_").arg(i), share, qMax(1, connectRate / numThreads), config);
+        QMetaObject::invokeMethod(swarm, &Swarm::start, Qt::QueuedConnection);
+        swarms.append(swarm);
+    }
+
+    const QString target = config.localPath.isEmpty() ? QStringLiteral("%1:%2").arg(config.address.toString()).arg(config.port)
+                                                      : QStringLiteral("%1 (shared memory)").arg(config.localPath);
+    fprintf(stdout, "%d bots on %d threads against %s for %ds\n", numBots, numThreads, qPrintable(target), duration);
+    fflush(stdout);
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    QTimer::singleShot(duration * 1000, &a, &QCoreApplication::quit);
+    a.exec();
+    const double seconds = elapsed.nsecsElapsed() / 1e9;
+
+    BotStats total;
+    for (Swarm *swarm : swarms) {
+        QMetaObject::invokeMethod(swarm, &Swarm::stop, Qt::BlockingQueuedConnection);
+        const BotStats &stats = swarm->get_stats();
+        total.latenciesNs += stats.latenciesNs;
+        total.actionsSent += stats.actionsSent;
+        total.actionsEchoed += stats.actionsEchoed;
+        total.stateRequests += stats.stateRequests;
+        total.errors += stats.errors;
+        total.connected += stats.connected;
+        total.seated += stats.seated;
+        total.disconnected += stats.disconnected;
+    }
+    qDeleteAll(swarms);
+
+    sort(total.latenciesNs.begin(), total.latenciesNs.end());
+
+    fprintf(stdout, "connected %d, seated %d, dropped %d\n", total.connected, total.seated, total.disconnected);
+    fprintf(stdout, "actions sent %lld, echoed %lld (%.1f/s), refused %lld, state requests %lld\n",
+            (long long)total.actionsSent, (long long)total.actionsEchoed, total.actionsEchoed / seconds,
+            (long long)total.errors, (long long)total.stateRequests);
+    fprintf(stdout, "action to broadcast latency (ms): p50 %.3f  p99 %.3f  p999 %.3f  max %.3f\n",
+            percentileMs(total.latenciesNs, 50), percentileMs(total.latenciesNs, 99),
+            percentileMs(total.latenciesNs, 99.9), total.latenciesNs.isEmpty() ? 0.0 : total.latenciesNs.last() / 1e6);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include "swarm.hpp"
+
+#define RAMP_INTERVAL_MS 10
+
+Swarm::Swarm(const QString &new_prefix, int new_numBots, int new_connectRate, const BotConfig &new_config)
+    : prefix(new_prefix)
+    , numBots(new_numBots)
+    , connectRate(qMax(1, new_connectRate))
+    , config(new_config) {
+
+    connect(&rampTimer, &QTimer::timeout, this, &Swarm::connectBatch);
+    moveToThread(&swarmThread);
+    swarmThread.start();
+}
+
+Swarm::~Swarm() {
+    // The bots' sockets belong to the swarm thread, so they go away there
+    QThread *owner = QThread::currentThread();
+    QMetaObject::invokeMethod(this, [this, owner]() {
+        qDeleteAll(bots);
+        bots.clear();
+        moveToThread(owner);
+    }, Qt::BlockingQueuedConnection);
+    swarmThread.quit();
+    swarmThread.wait();
+}
+
+const BotStats &Swarm::get_stats() const {
+    return stats;
+}
+
+void Swarm::start() {
+    rampTimer.start(RAMP_INTERVAL_MS);
+}
+
+void Swarm::stop() {
+    rampTimer.stop();
+    qDeleteAll(bots);
+    bots.clear();
+}
+
+void Swarm::connectBatch() {
+    const int batch = qMax(1, connectRate * RAMP_INTERVAL_MS / 1000);
+    for (int i = 0; i < batch && bots.size() < numBots; ++i) {
+        Bot *bot = new Bot(prefix + QString::number(bots.size()), config, &stats);
+        bots.append(bot);
+        bot->start();
+    }
+    if (bots.size() >= numBots) rampTimer.stop();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+
+#include "bot.hpp"
+using namespace std;
+
+// A thread's worth of bots. Connections are opened a batch at a time so that a few thousand
+// of them do not all land in the server's listen backlog at once
+class Swarm : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(Swarm)
+public:
+    // Bots are named prefix0, prefix1, ... and connect at connectRate per second
+    Swarm(const QString &prefix, int numBots, int connectRate, const BotConfig &config);
+    ~Swarm();
+
+    // Updated on the swarm thread, read it once stop() has returned
+    const BotStats &get_stats() const;
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void connectBatch();
+
+private:
+    QThread swarmThread;
+    QString prefix;
+    int numBots;
+    int connectRate;
+    BotConfig config;
+    BotStats stats;
+    QVector<Bot*> bots;
+    QTimer rampTimer;
+};
@@ -1,6 +1,7 @@
 TEMPLATE = subdirs
 
-SUBDIRS = client server
+SUBDIRS = client server serverd loadgen bots tests tests/network
 
 HEADERS += \
-    shared/appconfig.hpp
+    shared/appconfig.hpp \
+    shared/wireprotocol.hpp
@@ -0,0 +1,101 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include "tablestate.hpp"
+using namespace std;
+
+// Interface for house bots, which the server loads from shared libraries and seats at its
+// tables like any other player but without a connection. A bot library is built against
+// this header and exports:
+//
+//     HOUSE_BOT_EXPORT int house_bot_api_version() { return HOUSE_BOT_API_VERSION; }
+//     HOUSE_BOT_EXPORT HouseBot *create_house_bot(const char *config) { return new MyBot(config); }
+//
+// Everything on BotView, BotBudget, LegalActions, CardSet and Card is inline. A bot that
+// searches with TableState compiles tablestate.cpp, cards.cpp and zobrist.cpp into itself, as
+// bots/bots.pro does. Each bot gets a thread of its own and its calls arrive there one at a
+// time, so a slow bot only holds up itself. See bots/callbot.cpp for a complete one.
+#define HOUSE_BOT_API_VERSION 2
+
+#if defined(_WIN32)
+#define HOUSE_BOT_EXPORT extern "C" __declspec(dllexport)
+#else
+#define HOUSE_BOT_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+// The table as one seat sees it, a copy taken when the bot was called since the game moves on
+// without waiting for the bot. Other seats' hole cards are left out
+class BotView {
+public:
+    BotView(const TableState &new_table, int new_seat, int new_game_no, const LegalActions &new_legal)
+        : table(new_table), seat(new_seat), game_no(new_game_no), legal(new_legal) {
+        for (int index = 0; index < MAXPLAYERS; ++index) {
+            if (index != seat) table.hole_cards[index].clear();
+        }
+    }
+
+    int get_seat() const { return seat; }
+    int get_game_no() const { return game_no; }
+    int get_num_players() const { return table.num_players; }
+    Round get_round() const { return table.round; }
+    int get_pot() const { return table.pot; }
+    CardSet get_board() const { return table.board; }
+    CardSet get_hole_cards() const { return table.hole_cards[seat]; }
+
+    // Per seat, indexed by playerID like TableState
+    int get_stack(int index) const { return table.stack[index]; }
+    int get_to_call(int index) const { return table.to_call[index]; }
+    int get_contributed(int index) const { return table.contributed[index]; }
+    SeatMask get_seated() const { return table.seated_mask; }
+    SeatMask get_in_hand() const { return table.active_mask; }
+    SeatMask get_all_in() const { return table.allin_mask; }
+
+    int get_current_player() const { return table.current_player_index; }
+    int get_dealer() const { return table.dealer_index; }
+    int get_sb() const { return table.sb_index; }
+    int get_bb() const { return table.bb_index; }
+    // What this seat may do, only meaningful when it is asked to decide
+    const LegalActions& get_legal_actions() const { return legal; }
+
+private:
+    TableState table;
+    int seat;
+    int game_no;
+    LegalActions legal;
+};
+
+// Time a decision may take, counted from when the table asked for it. A bot that searches should
+// check expired() as it goes and answer with the best it has, once the time is up the table plays
+// a check or fold for it and throws its answer away
+class BotBudget {
+public:
+    explicit BotBudget(uint64_t new_limit_ns, uint64_t new_start_ns = now_ns()) : limit_ns(new_limit_ns), start_ns(new_start_ns) {}
+
+    uint64_t get_limit_ns() const { return limit_ns; }
+    uint64_t get_used_ns() const { return now_ns() - start_ns; }
+    bool expired() const { return get_used_ns() >= limit_ns; }
+
+    static uint64_t now_ns() {
+        return uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+private:
+    uint64_t limit_ns;
+    uint64_t start_ns;
+};
+
+class HouseBot {
+public:
+    virtual ~HouseBot() {}
+
+    // The cards are dealt and the blinds posted
+    virtual void onHandStart(const BotView &view) { (void)view; }
+    // Any seat's action, this one's included, as it is made and before the table applies it
+    virtual void onAction(const BotView &view, int seat, const Action &action) { (void)view; (void)seat; (void)action; }
+    // This seat is to act. An action the view's legal actions do not allow, or one that comes back
+    // after the budget is up, is replaced with a check or fold
+    virtual Action decide(const BotView &view, const BotBudget &budget) = 0;
+};
+
+typedef int (*HouseBotApiVersion)();
+typedef HouseBot *(*CreateHouseBot)(const char *config);
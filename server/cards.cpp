@@ -3,13 +3,6 @@
 #include "cards.hpp"
 using namespace std;
 
-Suit Card::get_suit() {
-    return suit;
-}
-Rank Card::get_rank() {
-    return rank;
-}
-
 string Card::to_string() const {
     static const char* suit_str[] = {"C", "D", "H", "S"};
     static const char* rank_str[] = {"","","2","3","4","5","6","7","8","9","T","J","Q","K","A"};
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <string>
 using namespace std;
@@ -13,10 +14,25 @@ private:
     Suit suit;
 public:
     Card(Rank r, Suit s) : rank(r), suit(s) {}
-    Suit get_suit();
-    Rank get_rank();
+    Suit get_suit() const { return suit; }
+    Rank get_rank() const { return rank; }
     string to_string() const;
     string to_filename() const;
+
+    // Dense index in [0, 52), used as the bit position within a CardSet
+    int to_index() const { return suit * 13 + (rank - TWO); }
+    static Card from_index(int index) { return Card(static_cast<Rank>(index % 13 + TWO), static_cast<Suit>(index / 13)); }
+};
+
+// Set of cards packed into one bit per card, cheap to copy and compare
+struct CardSet {
+    uint64_t mask = 0;
+
+    void add(const Card& card) { mask |= uint64_t(1) << card.to_index(); }
+    bool contains(const Card& card) const { return mask & (uint64_t(1) << card.to_index()); }
+    bool empty() const { return mask == 0; }
+    void clear() { mask = 0; }
+    bool operator==(const CardSet& other) const { return mask == other.mask; }
 };
 
 class Deck {
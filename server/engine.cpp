@@ -2,7 +2,8 @@
 
 Engine::Engine(QObject* parent)
     : QObject(parent)
-    , game(new GameState(1)) {
+    , game(new GameState(0))
+    , gameTimer(this) {
 
     connect(&gameTimer, &QTimer::timeout, this, &Engine::gameLoop);
     gameTimer.start(1000);
@@ -10,34 +11,61 @@ Engine::Engine(QObject* parent)
 }
 
 void Engine::startGame() {
-    if (game->get_players().size() == 1) return; // game cannot start when there is only 1 player
+    if (seat_count(game->get_table().seated_mask) < 2) return; // game cannot start with fewer than 2 players
     state = INITGAME;
 }
 
+int Engine::addPlayer(const QString& username) {
+    int playerID = game->add_player(username.toStdString());
+    if (playerID != -1 && state == IDLE) startGame();
+    return playerID;
+}
+
+void Engine::removePlayer(int playerID) {
+    game->remove_player(playerID);
+}
+
+bool Engine::is_seated(int playerID) {
+    return game->get_table().get_status(playerID) != EMPTY;
+}
+
 EngineState Engine::get_state() {
     return state;
 }
 
+LegalActions Engine::get_legal_actions() {
+    return game->get_legal_actions();
+}
+
 void Engine::makeAction(const Action& action) {
     pendingAction = action;
     actionReady = true;
+    actionQueuedAt = Metrics::now();
+}
+
+bool Engine::has_pending_action() {
+    return actionReady;
 }
 
 int Engine::get_current_playerID() {
     return game->get_current_player().get_playerID();
 }
 
-const vector<Player> Engine::get_players() {
+const vector<Player>& Engine::get_players() {
     return game->get_players();
 }
 
-const Player Engine::get_dealer() {
+int Engine::get_stack(int playerID) {
+    return game->get_stack(playerID);
+}
+
+const Player& Engine::get_dealer() {
     return game->get_current_dealer();
 }
-const Player Engine::get_sb() {
+const Player& Engine::get_sb() {
     return game->get_sb();
 }
-const Player Engine::get_bb() {
+const Player& Engine::get_bb() {
     return game->get_bb();
 }
 int Engine::get_game_no() {
@@ -52,9 +80,22 @@ int Engine::get_pot() {
 vector<Card> Engine::get_board() {
     return game->get_board();
 }
+uint64_t Engine::get_state_version() {
+    return game->get_version();
+}
+const TableState& Engine::get_table() {
+    return game->get_table();
+}
+
+void Engine::set_table_id(int id) {
+    tableId = id;
+}
 
 void Engine::gameLoop() {
+    TRACE_SCOPE_ARG("engine", "tick", "table", tableId);
+    const uint64_t start = Metrics::now();
     tick();
+    Metrics::recordSince(STAGE_ENGINE_TICK, start);
     emit gameStateUpdated(*game);
 }
 
@@ -63,19 +104,29 @@ void Engine::tick() {
     case IDLE:
         break; // do nothing
     case INITGAME:
+        if (!game->init_new_game()) {
+            // Wait for more players rather than ending the process, other tables may still be playing
+            state = IDLE;
+            break;
+        }
         print_game_state();
-        game->init_new_game();
-        qDebug() << "SB has bet $" << SMALLBLIND << "\nBB has bet $" << BIGBLIND << "\n";
+        LOG_DEBUG(LOG_ENGINE, "SB has bet $%d, BB has bet $%d", SMALLBLIND, BIGBLIND);
         state = STARTROUND;
         print_players_status();
         break;
     case STARTROUND:
         print_round_state();
-        state = PLAYERACTION;
+        // Skip straight through the round if everyone left is all in
+        state = game->betting_over() ? BETTINGOVER : PLAYERACTION;
         break;
     case PLAYERACTION:
         if (!actionReady) return; // wait for user to press button
-        game->make_action(pendingAction);
+        {
+            const uint64_t start = Metrics::now();
+            Metrics::record(STAGE_ENGINE_QUEUE, start - actionQueuedAt);
+            game->make_action(pendingAction);
+            Metrics::recordSince(STAGE_ENGINE_APPLY, start);
+        }
         actionReady = false;
         if (game->betting_over()) {
             state = BETTINGOVER;
@@ -105,35 +156,25 @@ void Engine::tick() {
 
 
 void Engine::print_game_state() {
-    qDebug() << "================|GAME " << game->get_gameNo() << "|================\n";
-    qDebug() << "Dealer: Player " << game->get_current_dealer().get_playerID() << "\n";
-    qDebug() << "SB: Player " << game->get_sb().get_playerID() << "\n";
-    qDebug() << "BB: Player " << game->get_bb().get_playerID() << "\n";
-    qDebug() << "========================================\n";
+    if (!LOG_DEBUG_ENABLED(LOG_ENGINE)) return;
+    Logger::write(LOG_LEVEL_DEBUG, LOG_ENGINE, "Game %d: dealer %d, SB %d, BB %d", game->get_gameNo(),
+                  game->get_current_dealer().get_playerID(), game->get_sb().get_playerID(), game->get_bb().get_playerID());
 }
 
 void Engine::print_round_state() {
-    unordered_map<Round, string> str_to_enum = {{PREFLOP, "preflop"}, {FLOP, "flop"}, {TURN, "turn"}, {RIVER, "RIVER"}};
-    qDebug() << "Round: " << str_to_enum[game->get_round()];
-    qDebug() << "Pot: $" << game->get_pot();
-    QString board_output = "Board: ";
-    for (Card card : game->get_board()) board_output += card.to_string() + " ";
-    qDebug().noquote() << board_output;
-    qDebug() << "\n";
+    if (!LOG_DEBUG_ENABLED(LOG_ENGINE)) return;
+    static const char* const round_names[] = {"preflop", "flop", "turn", "river"};
+    string board_output;
+    for (const Card& card : game->get_board()) board_output += card.to_string() + " ";
+    Logger::write(LOG_LEVEL_DEBUG, LOG_ENGINE, "Round: %s, pot: $%d, board: %s", round_names[game->get_round()], game->get_pot(), board_output.c_str());
 }
 
 void Engine::print_players_status() {
-
-    qDebug() << "------------------------PLAYERS STATUS----------------------";
-    for (Player& player : game->get_players()) {
-        qDebug() << "Player " << player.get_playerID() << ":";
-        qDebug() << "Stack: $" << player.get_stack();
-        QString hole_cards_output = "Hole Cards: ";
-        for (Card hole_card : player.get_hole_cards()) hole_cards_output += hole_card.to_string() + " ";
-        qDebug().noquote() << hole_cards_output;
-        qDebug() << "To call: " << player.get_to_call();
-        qDebug() << "\n";
+    if (!LOG_DEBUG_ENABLED(LOG_ENGINE)) return;
+    for (const Player& player : game->get_players()) {
+        string hole_cards_output;
+        for (const Card& hole_card : player.get_hole_cards()) hole_cards_output += hole_card.to_string() + " ";
+        Logger::write(LOG_LEVEL_DEBUG, LOG_ENGINE, "Player %d: stack $%d, hole cards: %s, to call: %d", player.get_playerID(),
+                      game->get_stack(player.get_playerID()), hole_cards_output.c_str(), game->get_to_call(player.get_playerID()));
     }
-    qDebug() << "------------------------------------------------------------";
-
 }
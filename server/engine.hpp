@@ -4,6 +4,8 @@
 #include <QObject>
 #include <QTimer>
 #include "game.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 using namespace std;
 
 enum EngineState {
@@ -22,18 +24,32 @@ class Engine : public QObject
 public:
     explicit Engine(QObject* parent = nullptr);
     void startGame();
+    // Seats a player and starts the game once two are seated, returns the playerID or -1 if full
+    int addPlayer(const QString& username);
+    // Frees a seat. A player still in the hand is not folded here, the server acts for the seat
+    void removePlayer(int playerID);
+    bool is_seated(int playerID);
 
     EngineState get_state();
+    LegalActions get_legal_actions();
     void makeAction(const Action& action);
+    // An action has been made and is waiting for the next tick to apply it
+    bool has_pending_action();
     int get_current_playerID();
-    const vector<Player> get_players();
-    const Player get_dealer();
-    const Player get_sb();
-    const Player get_bb();
+    const vector<Player>& get_players();
+    int get_stack(int playerID);
+    const Player& get_dealer();
+    const Player& get_sb();
+    const Player& get_bb();
     int get_game_no();
     Round get_round();
     int get_pot();
     vector<Card> get_board();
+    uint64_t get_state_version();
+    // Read only, for house bots to look at without a copy
+    const TableState& get_table();
+    // Only used to label trace spans
+    void set_table_id(int id);
 
 signals:
     void gameStateUpdated(const GameState& gameState);
@@ -42,10 +58,12 @@ private slots:
 private:
     GameState* game;
     EngineState state = IDLE;
-    QTimer gameTimer;
+    int tableId = -1;
+    QTimer gameTimer; // parented to the engine so that it follows it onto the table thread
 
     Action pendingAction = Action(FOLD, 0);
     bool actionReady = false;
+    uint64_t actionQueuedAt = 0; // Metrics::now() when pendingAction was set
 
     void tick();
     void nextState();
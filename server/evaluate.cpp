@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <unordered_map>
 #include "evaluate.hpp"
+#include "trace.hpp"
 using namespace std;
 
 bool HandScore::operator<(const HandScore& other) const {
@@ -141,6 +142,7 @@ HandScore Evaluator::evaluate_five_card_hand(vector<Card>& hand) {
 }
 
 HandScore Evaluator::evaluate_table(vector<Card> player, vector<Card> board) {
+    TRACE_SCOPE("game", "evaluate_table");
 
     // get the full 7 card hand for each player
     vector<Card> hand = player;
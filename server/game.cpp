@@ -1,25 +1,19 @@
+#include <algorithm>
+#include <stdexcept>
 #include <unordered_map>
 #include "game.hpp"
+#include "pots.hpp"
 using namespace std;
 
 vector<string> usernames = {"Michael", "Alice", "Bob", "Charlie", "David", "Evan"};
 
 GameState::GameState(int num_players) {
     gameNo = 0;
-    round = PREFLOP;
-    pot = 0;
+    version = 0;
+    table.init(num_players, INITIALSTACK);
     community_cards = {};
     deck = Deck();
-    for (int i = 0; i < num_players; ++i) players.emplace_back(i, usernames[i], INITIALSTACK);
-    current_player_index = -1;
-    dealer_index = -1;
-    sb_index = -1;
-    bb_index = -1;
-    last_raiser_index = -1;
-    last_to_act_index = 0;
-    acted = vector<bool>(players.size(), false);
-    min_raise = SMALLBLIND;
-    max_raise = INITIALSTACK;
+    for (int i = 0; i < num_players; ++i) players.emplace_back(i, usernames[i]);
     history = {};
     history_string = "";
     evaluator = Evaluator();
@@ -30,78 +24,71 @@ int GameState::get_gameNo() const {
 }
 
 Round GameState::get_round() const {
-    return round;
+    return table.round;
 }
 
 void GameState::next_round() {
-    round = static_cast<Round>((round + 1) % 4);
-    current_player_index = (dealer_index + 1) % players.size();
-    while (get_current_player().has_folded()) current_player_index++;
-    last_to_act_index = current_player_index;
-    last_raiser_index = -1;
+    table.next_round();
+    version++;
 
-    reset_acted();
-
-    unordered_map<Round, string> str_to_enum = {{PREFLOP, "preflop"}, {FLOP, "flop"}, {TURN, "turn"}, {RIVER, "RIVER"}};
-    qDebug() << "================|NEW ROUND " << str_to_enum[get_round()]  << "|================";
+    static const char* const round_names[] = {"preflop", "flop", "turn", "river"};
+    LOG_DEBUG(LOG_GAME, "New round: %s", round_names[get_round()]);
 }
 
 int GameState::get_pot() const {
-    return pot;
+    return table.pot;
 }
 
 vector<Card>& GameState::get_board() {
     return community_cards;
 }
 void GameState::deal_to_board(Card new_card) {
-    if (community_cards.size() < 5) community_cards.push_back(new_card);
+    if (community_cards.size() < 5) {
+        community_cards.push_back(new_card);
+        table.deal_to_board(new_card);
+        version++;
+    }
 }
 
 vector<Player>& GameState::get_players() {
     return players;
 }
+int GameState::add_player(const string& username) {
+    int index = table.seat_player(INITIALSTACK);
+    if (index == -1) return -1;
+    if (index < int(players.size())) players[index] = Player(index, username);
+    else players.emplace_back(index, username);
+    version++;
+    return index;
+}
+void GameState::remove_player(int index) {
+    table.unseat_player(index);
+    version++;
+}
+int GameState::get_stack(int index) const {
+    return table.stack[index];
+}
+int GameState::get_to_call(int index) const {
+    return table.to_call[index];
+}
+bool GameState::has_folded(int index) const {
+    return table.has_folded(index);
+}
 Player& GameState::get_current_player() {
-    return players[current_player_index];
+    return players[table.current_player_index];
 }
 Player& GameState::get_current_dealer() {
-    return players[dealer_index];
+    return players[table.dealer_index];
 }
 Player& GameState::get_sb() {
-    return players[sb_index];
+    return players[table.sb_index];
 }
 Player& GameState::get_bb() {
-    return players[bb_index];
-}
-void GameState::set_dealer_sb_bb() {
-    do {
-        dealer_index = (dealer_index + 1) % players.size();
-    } while (players[dealer_index].has_folded());
-
-    sb_index = (dealer_index + 1) % players.size();
-    while (players[sb_index].has_folded()) sb_index = (sb_index + 1) % players.size();
-
-    bb_index = (sb_index + 1) % players.size();
-    while (players[bb_index].has_folded()) bb_index = (bb_index + 1) % players.size();
-}
-void GameState::next_player() {
-    do {
-        current_player_index = (current_player_index + 1) % players.size();
-    } while (get_current_player().has_folded());
-
-    min_raise = max(get_current_player().get_to_call(), BIGBLIND);
-    max_raise = get_current_player().get_stack();
+    return players[table.bb_index];
 }
 
 bool GameState::get_acted(int index) const {
-    return acted[index];
-}
-void GameState::set_acted(int index) {
-    acted[index] = true;
-}
-void GameState::reset_acted() {
-    for (int i = 0; i < int(acted.size()); ++i) {
-        if (!players[i].has_folded()) acted[i] = false;
-    }
+    return table.has_acted(index);
 }
 
 vector<pair<Player,Action>>& GameState::get_history() { return history; }
@@ -133,80 +120,56 @@ Evaluator& GameState::get_evaluator() {
     return evaluator;
 }
 
-vector<int> GameState::not_folded() const {
-    vector<int> still_in;
-    for (int i = 0; i < int(players.size()); ++i) {
-        if (!players[i].has_folded()) still_in.push_back(i);
-    }
-    return still_in;
+const TableState& GameState::get_table() const {
+    return table;
+}
+TableState GameState::snapshot() const {
+    return table;
+}
+uint64_t GameState::get_hash() const {
+    return table.hash;
+}
+uint64_t GameState::get_version() const {
+    return version;
+}
+
+SeatMask GameState::not_folded() const {
+    return table.active_mask;
 }
 
 bool GameState::game_end() const {
-    if (not_folded().size() == 1) return true;
-    if (round == RIVER && betting_over()) return true;
-    return false;
+    return table.game_end();
 }
 
 bool GameState::betting_over() const {
-    if (not_folded().size() == 1) return true;
-    for (int i = 0; i < int(players.size()); ++i) {
-        if (!players[i].has_folded() && !get_acted(i)) return false;
-    }
-    if (last_raiser_index == -1) return current_player_index == last_to_act_index;
+    return table.betting_over();
+}
 
-    int player_before_index = (current_player_index - 1 + players.size()) % players.size();
-    while (players[player_before_index].has_folded()) player_before_index = (player_before_index - 1 + players.size()) % players.size();
-    return player_before_index == last_to_act_index;
+LegalActions GameState::get_legal_actions() const {
+    return table.legal_actions();
 }
 
 int GameState::make_action(Action new_action) {
+    TRACE_SCOPE("game", "make_action");
 
     Player& player = get_current_player();
-    bool all_in = false;
+    SeatMask seat = seat_bit(player.get_playerID());
+    bool was_all_in = table.allin_mask & seat;
 
-    switch (new_action.type) {
-    case FOLD:
-        player.fold();
-        while (players[last_to_act_index].has_folded()) last_to_act_index = (last_to_act_index - 1) + players.size() % players.size();
-        break;
-    case CALL:
-        pot += player.bet(player.get_to_call());
-        player.set_to_call(0);
-        break;
-    case RAISE:
-        if (new_action.amount < min_raise) return -1; // needs to be at least min raise
-        if (new_action.amount >= player.get_stack()) all_in = true;
-        pot += player.bet(player.get_to_call() + new_action.amount);
-        player.set_to_call(0);
-        last_raiser_index = current_player_index;
-        last_to_act_index = (current_player_index - 1 + players.size()) % players.size();
-        while (players[last_to_act_index].has_folded()) last_to_act_index = (last_to_act_index - 1 + players.size()) % players.size();
-        reset_acted();
-        for (int i = 0; i < int(players.size()); ++i) {
-            if (i != current_player_index && !players[i].has_folded()) {
-                players[i].set_to_call(players[i].get_to_call() + new_action.amount);
-            }
-        }
-        break;
-    case CHECK:
-        if (player.get_to_call() != 0) {
-            qDebug() << "Cannot check, please call or raise";
-            return -1;
-        }
-        break;
-    default:
-        throw invalid_argument("Invalid action type");
+    if (table.make_action(new_action) == -1) {
+        if (new_action.type == CHECK) LOG_DEBUG(LOG_GAME, "Cannot check, please call or raise");
+        return -1;
     }
-    set_acted(current_player_index);
+    if (new_action.type == FOLD) player.clear_hole_cards();
+    version++;
 
     update_history(player, new_action);
-    if (all_in) history_string += "\n   ALL IN";
-    next_player();
+    if (!was_all_in && (table.allin_mask & seat)) history_string += "\n   ALL IN";
     return 0;
 }
 
 void GameState::draw_community_cards() {
-    switch (round) {
+    switch (table.round) {
     case PREFLOP:
         deck.burn();
         for (int i = 0; i < 3; ++i) {
@@ -219,7 +182,7 @@ void GameState::draw_community_cards() {
         deal_to_board(deck.draw());
         break;
     case RIVER:
-        qDebug() << "No more cards to draw onto table";
+        LOG_WARN(LOG_GAME, "No more cards to draw onto table");
         break;
     default:
         throw invalid_argument("Invalid round");
@@ -228,120 +191,99 @@ void GameState::draw_community_cards() {
 
 vector<int> GameState::compute_winners_and_distribute_pot() {
 
-    vector<int> still_in = not_folded();
-
-    if (still_in.size() > 1 && community_cards.size() == 5) {
-        for (int index : still_in) {
-            qDebug() << "Player " << players[index].get_playerID() << ": "
-                     << evaluator.evaluate_table(players[index].get_hole_cards(), get_board()).to_string();
+    SeatMask still_in = not_folded();
+    int num_still_in = seat_count(still_in);
+    bool showdown = num_still_in > 1 && community_cards.size() == 5;
+
+    // Evaluate each hand once and rank them best first, equal hands share a rank.
+    // Last player standing wins without a showdown (the board may not be complete)
+    int rank[MAXPLAYERS];
+    for (int i = 0; i < MAXPLAYERS; ++i) rank[i] = MAXPLAYERS;
+    vector<pair<HandScore, int>> evaluated;
+    if (num_still_in > 1) {
+        for (SeatMask seats = still_in; seats; seats &= seats - 1) {
+            int index = lowest_seat(seats);
+            evaluated.emplace_back(get_evaluator().evaluate_table(players[index].get_hole_cards(), get_board()), index);
+            if (showdown) LOG_DEBUG(LOG_GAME, "Player %d: %s", players[index].get_playerID(), evaluated.back().first.to_string().c_str());
         }
-    }
-
-    vector<pair<int, HandScore>> evaluated;
-    HandScore best_score;
-
-    for (int index : still_in) {
-        HandScore score = get_evaluator().evaluate_table(players[index].get_hole_cards(), get_board());
-        evaluated.emplace_back(index, score);
-
-        if (evaluated.size() == 1 || best_score < score) {
-            best_score = score;
+        sort(evaluated.begin(), evaluated.end(), [](const pair<HandScore, int>& a, const pair<HandScore, int>& b) {
+            return b.first < a.first;
+        });
+        for (int i = 0; i < int(evaluated.size()); ++i) {
+            bool tied = i > 0 && !(evaluated[i].first < evaluated[i - 1].first);
+            rank[evaluated[i].second] = tied ? rank[evaluated[i - 1].second] : i;
         }
+    } else {
+        rank[lowest_seat(still_in)] = 0;
     }
 
-    vector<int> winners;
-    for (const auto& [index, score] : evaluated) {
-        if (!(score < best_score) && !(best_score < score)) { // i.e. score == best_score
-            winners.push_back(index);
-        }
-    }
-
-    if (winners.size() == 1) qDebug() << "Winner:";
-    else qDebug() << "Winners:";
+    Pot pots[MAXPLAYERS];
+    int num_pots = build_pots(table, pots);
+    int payouts[MAXPLAYERS];
+    settle_pots(table, pots, num_pots, rank, payouts);
 
-    int winnings = get_pot() / winners.size();
-    int total = get_pot();
+    vector<int> winners;
     string win_message = "";
 
-    for (int index : winners) {
-        total -= winnings;
-        int overall_winnings;
-        if (total > 0 && total < winnings) overall_winnings = winnings + total; // handling remainders if not even split
-        else overall_winnings = winnings;
-        players[index].win(overall_winnings);
-        win_message += "\n> Player " + to_string(get_players()[index].get_playerID()) + " wins $" + to_string(overall_winnings);
-        if (still_in.size() > 1 && community_cards.size() == 5) {
-            win_message += " with " + evaluator.evaluate_table(get_players()[index].get_hole_cards(), get_board()).to_string();
+    for (int index = 0; index < table.num_players; ++index) {
+        if (payouts[index] == 0) continue;
+        winners.push_back(index);
+        table.award(index, payouts[index]);
+        version++;
+        LOG_INFO(LOG_GAME, "Game %d: player %d wins $%d", gameNo, index, payouts[index]);
+        win_message += "\n> Player " + to_string(get_players()[index].get_playerID()) + " wins $" + to_string(payouts[index]);
+        if (showdown) {
+            for (const auto& [score, seat] : evaluated) {
+                if (seat == index) win_message += " with " + score.to_string();
+            }
         }
     }
-    qDebug() << win_message;
+    if (num_pots > 1) win_message += "\n   (" + to_string(num_pots - 1) + " side pot" + (num_pots > 2 ? "s" : "") + ")";
+
     history_string += win_message;
 
     return winners;
 }
 
-void GameState::init_new_game() {
+bool GameState::init_new_game() {
 
     gameNo++;
-    round = PREFLOP;
-    pot = 0;
+    version++;
     community_cards = {};
     history.clear();
-    reset_acted();
-
-    for (Player& player: players) {
-        if (player.get_stack() == 0) player.fold();
-        else {
-            player.set_to_call(0);
-            player.unfold();
-        }
-    }
+    for (Player& player : players) player.clear_hole_cards();
 
-    int players_still_in = 0;
-    for (Player& player: players) {
-        if (!player.has_folded()) players_still_in++;
-    }
-    if (players_still_in < 2) {
-        qDebug() << "We have a winner!";
-        QApplication::quit();
+    if (table.start_hand() < 2) {
+        LOG_INFO(LOG_GAME, "We have a winner!");
+        return false;
     }
 
-    set_dealer_sb_bb();
-    current_player_index = (dealer_index + 1) % players.size();
-    while (players[current_player_index].has_folded()) current_player_index = (dealer_index + 1) % players.size();
-    last_raiser_index = -1;
-    last_to_act_index = dealer_index;
-
-    min_raise = SMALLBLIND;
-    max_raise = get_current_player().get_stack();
-
     if (gameNo > 1) history_string += "\n";
     history_string += "> -----Game " + to_string(gameNo) + "-----";
 
-    // SB and BB make starting bets
-    make_action(Action(RAISE, static_cast<int>(SMALLBLIND)));
-    make_action(Action(RAISE, static_cast<int>(BIGBLIND - SMALLBLIND)));
-    last_to_act_index = get_bb().get_playerID(); // Give BB chance to check/raise again
+    // SB and BB make starting bets, which are not held to the min raise
+    update_history(get_current_player(), Action(RAISE, static_cast<int>(SMALLBLIND)));
+    table.post_blind(SMALLBLIND);
+    update_history(get_current_player(), Action(RAISE, static_cast<int>(BIGBLIND - SMALLBLIND)));
+    table.post_blind(BIGBLIND - SMALLBLIND);
 
     // Reinitialize deck and deal hole cards to players
     deck.reshuffle();
     for (Player& player : players) {
-        if (player.get_stack() > 0 && !player.has_folded()) {
+        int index = player.get_playerID();
+        if (!table.has_folded(index)) {
             vector<Card> hole_cards = { deck.draw(), deck.draw() };
             player.deal_hole_cards(hole_cards);
+            table.deal_hole_cards(index, hole_cards[0], hole_cards[1]);
         }
     }
+    return true;
 }
 
 void GameState::debug_state() {
-    qDebug() << "Current Player Index: " << current_player_index;
-    qDebug() << "Last Raiser Index: " << last_raiser_index;
-    qDebug() << "Last To Act Index: " << last_to_act_index;
-    QString acted_output = "Acted: ";
-    for (int i = 0; i < int(acted.size()); ++i) {
-        acted_output += (acted[i] ? "1" : "0");
-        acted_output += " ";
-    }
-    qDebug().noquote() << acted_output;
-    qDebug() << "\n";
+    if (!LOG_DEBUG_ENABLED(LOG_GAME)) return;
+    string acted_output;
+    for (int i = 0; i < table.num_players; ++i) acted_output += table.has_acted(i) ? "1 " : "0 ";
+    Logger::write(LOG_LEVEL_DEBUG, LOG_GAME, "Current player index: %d, last raiser index: %d, acted: %s",
+                  table.current_player_index, table.last_raiser_index, acted_output.c_str());
 }
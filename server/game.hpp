@@ -1,50 +1,26 @@
 #pragma once
 #include <vector>
 #include <string>
-#include <qDebug>
 #include "cards.hpp"
 #include "evaluate.hpp"
 #include "player.hpp"
+#include "tablestate.hpp"
+#include "logger.hpp"
+#include "trace.hpp"
 
-#include <QApplication>
 using namespace std;
 
-#define SMALLBLIND 1
-#define BIGBLIND 2
-#define INITIALSTACK 200
-
-#define MAXPLAYERS 6
-
-enum Round { PREFLOP, FLOP, TURN, RIVER };
-
-enum ActionType { FOLD, CALL, RAISE, CHECK };
-
-struct Action {
-    ActionType type;
-    int amount; // for raise only
-    Action(ActionType new_type, int new_amount) : type(new_type), amount(new_amount) {}
-};
-
 class GameState {
 private:
     int gameNo;
-    Round round;
-    int pot;
+    TableState table;
     vector<Card> community_cards;
     Deck deck;
     vector<Player> players;
-    int current_player_index;
-    int dealer_index;
-    int sb_index;
-    int bb_index;
-    int last_raiser_index;
-    int last_to_act_index;
-    vector<bool> acted;
-    int min_raise;
-    int max_raise;
     vector<pair<Player,Action>> history;
     string history_string;
     Evaluator evaluator;
+    uint64_t version; // bumped by every change to the game, never goes backwards
 public:
 
     GameState(int num_players);
@@ -60,15 +36,19 @@ public:
     void deal_to_board(Card new_card);
 
     vector<Player>& get_players();
+    // Returns the new player's playerID, or -1 if every seat is taken. A seat that was left
+    // can be given to a new player, who takes over its playerID
+    int add_player(const string& username);
+    // See TableState::unseat_player, the Player stays in players so that playerIDs keep their index
+    void remove_player(int index);
+    int get_stack(int index) const;
+    int get_to_call(int index) const;
+    bool has_folded(int index) const;
     Player& get_current_player();
     Player& get_current_dealer();
     Player& get_sb();
     Player& get_bb();
-    void set_dealer_sb_bb();
-    void next_player();
     bool get_acted(int index) const;
-    void set_acted(int index);
-    void reset_acted();
 
     vector<pair<Player,Action>>& get_history();
     pair<Player,Action> get_last_action() const;
@@ -77,18 +57,26 @@ public:
 
     Evaluator& get_evaluator();
 
-    vector<int> not_folded() const;
+    // Betting state that bots and solvers can copy and search with make/unmake_action
+    const TableState& get_table() const;
+    TableState snapshot() const;
+    uint64_t get_hash() const;
+    uint64_t get_version() const;
+
+    SeatMask not_folded() const;
 
     bool game_end() const;
 
     bool betting_over() const;
+    LegalActions get_legal_actions() const;
     int make_action(Action new_action);
 
     void draw_community_cards();
 
     vector<int> compute_winners_and_distribute_pot();
 
-    void init_new_game();
+    // Returns false when fewer than two players have chips left and there is no hand to play
+    bool init_new_game();
 
     void debug_state();
 };
@@ -0,0 +1,225 @@
+#include "housebots.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+#include <exception>
+
+#include <QFileInfo>
+#include <QHash>
+#include <QLibrary>
+#include <QMutex>
+#include <QTimer>
+
+const BotLibrary *BotLibrary::load(const QString &path, QString *error) {
+
+    // Seats that play the same library share it
+    static QHash<QString, BotLibrary*> loaded;
+    const QString key = QFileInfo(path).absoluteFilePath();
+    if (BotLibrary *library = loaded.value(key)) return library;
+
+    QLibrary handle(path);
+    if (!handle.load()) {
+        *error = handle.errorString();
+        return nullptr;
+    }
+    HouseBotApiVersion version = reinterpret_cast<HouseBotApiVersion>(handle.resolve("house_bot_api_version"));
+    CreateHouseBot factory = reinterpret_cast<CreateHouseBot>(handle.resolve("create_house_bot"));
+    if (!version || !factory) {
+        *error = QStringLiteral("%1 does not export house_bot_api_version and create_house_bot").arg(path);
+        return nullptr;
+    }
+    if (version() != HOUSE_BOT_API_VERSION) {
+        *error = QStringLiteral("%1 was built for bot API version %2, the server has %3").arg(path).arg(version()).arg(HOUSE_BOT_API_VERSION);
+        return nullptr;
+    }
+
+    BotLibrary *library = new BotLibrary();
+    library->name = QFileInfo(path).baseName();
+    library->factory = factory;
+    loaded.insert(key, library);
+    return library;
+}
+
+HouseBot *BotLibrary::create(const QString &config) const {
+    try {
+        return factory(config.toUtf8().constData());
+    } catch (const exception &e) {
+        LOG_ERROR(LOG_SERVER, "House bot %s failed to start: %s", qPrintable(name), e.what());
+        return nullptr;
+    }
+}
+
+QString BotLibrary::get_name() const {
+    return name;
+}
+
+// Where a bot's thread sends its answers. The seat clears owner when it goes, so a bot still
+// stuck in decide() by then has nowhere to send one
+struct BotReplies {
+    QMutex mutex;
+    QObject *context;
+    SeatedBot *owner;
+
+    // From the bot's thread, call runs on context's thread if the seat is still there
+    static void send(const shared_ptr<BotReplies> &replies, function<void(SeatedBot*)> call) {
+        QMutexLocker lock(&replies->mutex);
+        if (!replies->owner) return;
+        QMetaObject::invokeMethod(replies->context, [replies, call]() {
+            if (replies->owner) call(replies->owner);
+        }, Qt::QueuedConnection);
+    }
+};
+
+SeatedBot::SeatedBot(HouseBot *new_bot, const QString &new_name, int new_seat, QObject *context)
+    : bot(new_bot)
+    , name(new_name)
+    , seat(new_seat)
+    , thread(new QThread())
+    , runner(new QObject())
+    , replies(new BotReplies()) {
+
+    replies->context = context;
+    replies->owner = this;
+    thread->setObjectName(QStringLiteral("bot-%1").arg(name));
+    runner->moveToThread(thread);
+    thread->start();
+    const string traceName = "bot-" + name.toStdString();
+    QMetaObject::invokeMethod(runner, [traceName]() { Trace::setThreadName(traceName); }, Qt::QueuedConnection);
+}
+
+SeatedBot::~SeatedBot() {
+    {
+        QMutexLocker lock(&replies->mutex);
+        replies->owner = nullptr;
+    }
+    // Anything still queued for the bot is dropped with the runner
+    thread->quit();
+    if (!thread->wait(HOUSE_BOT_STOP_MS)) {
+        LOG_ERROR(LOG_SERVER, "House bot %s is stuck and was left running", qPrintable(name));
+        return;
+    }
+    delete runner;
+    delete thread;
+    delete bot;
+}
+
+QString SeatedBot::get_name() const {
+    return name;
+}
+
+int SeatedBot::get_seat() const {
+    return seat;
+}
+
+void SeatedBot::hand_started(const BotView &view) {
+    if (benched) return;
+    notify([view](HouseBot *target) { target->onHandStart(view); }, "at the start of a hand");
+}
+
+void SeatedBot::action_made(const BotView &view, int actor, const Action &action) {
+    if (benched) return;
+    notify([view, actor, action](HouseBot *target) { target->onAction(view, actor, action); }, "on an action");
+}
+
+void SeatedBot::notify(function<void(HouseBot*)> call, const char *when) {
+    HouseBot *target = bot;
+    const QString botName = name;
+    QMetaObject::invokeMethod(runner, [target, call, when, botName]() {
+        try {
+            call(target);
+        } catch (const exception &e) {
+            LOG_WARN(LOG_SERVER, "House bot %s threw %s: %s", qPrintable(botName), when, e.what());
+        }
+    }, Qt::QueuedConnection);
+}
+
+void SeatedBot::decide(const BotView &view, uint64_t budgetNs, function<void(const Action&)> new_answered) {
+
+    // What a player who ran out of time does
+    const LegalActions &new_legal = view.get_legal_actions();
+    const Action fallback(new_legal.can(CHECK) ? CHECK : FOLD, 0);
+    if (benched) {
+        new_answered(fallback);
+        return;
+    }
+    if (deciding) {
+        // Its last decision missed the deadline and the bot has yet to come back from it
+        Metrics::add(COUNTER_BOT_OVERRUNS);
+        strike("was still deciding when its next turn came");
+        new_answered(fallback);
+        return;
+    }
+
+    answered = move(new_answered);
+    legal = new_legal;
+    deciding = true;
+    const quint64 decision = ++decisions;
+
+    HouseBot *target = bot;
+    const QString botName = name;
+    const shared_ptr<BotReplies> to = replies;
+    const uint64_t asked = BotBudget::now_ns();
+    QMetaObject::invokeMethod(runner, [target, botName, to, view, budgetNs, asked]() {
+        TRACE_SCOPE("bot", "house_bot_decide");
+        const BotBudget budget(budgetNs, asked);
+        Action action(FOLD, 0);
+        bool threw = false;
+        try {
+            action = target->decide(view, budget);
+        } catch (const exception &e) {
+            LOG_WARN(LOG_SERVER, "House bot %s threw while deciding: %s", qPrintable(botName), e.what());
+            threw = true;
+        }
+        const uint64_t used = budget.get_used_ns();
+        BotReplies::send(to, [action, threw, used](SeatedBot *owner) { owner->answer(action, threw, used); });
+    }, Qt::QueuedConnection);
+
+    // Rounded up to whole milliseconds, plus one for the answer to get back
+    const int deadlineMs = int((budgetNs + 999999) / 1000000) + 1;
+    QTimer::singleShot(deadlineMs, Qt::PreciseTimer, replies->context, [to, decision]() {
+        if (to->owner) to->owner->deadline_passed(decision);
+    });
+}
+
+void SeatedBot::answer(const Action &action, bool threw, uint64_t used) {
+
+    // Decisions are only asked for one at a time, so this is the last one
+    deciding = false;
+    Metrics::record(STAGE_BOT_DECIDE, used);
+    if (!answered) return; // too late, the table has moved on
+
+    const function<void(const Action&)> done = move(answered);
+    answered = nullptr;
+    const Action fallback(legal.can(CHECK) ? CHECK : FOLD, 0);
+    if (threw) {
+        strike("threw");
+        done(fallback);
+        return;
+    }
+    if (!legal.allows(action)) {
+        LOG_WARN(LOG_SERVER, "House bot %s made an action it is not allowed", qPrintable(name));
+        strike("made an action it is not allowed");
+        done(fallback);
+        return;
+    }
+    strikes = 0;
+    done(action);
+}
+
+void SeatedBot::deadline_passed(quint64 decision) {
+    if (decision != decisions || !answered) return;
+
+    const function<void(const Action&)> done = move(answered);
+    answered = nullptr;
+    Metrics::add(COUNTER_BOT_OVERRUNS);
+    LOG_WARN(LOG_SERVER, "House bot %s did not answer within its budget", qPrintable(name));
+    strike("went over its budget");
+    done(Action(legal.can(CHECK) ? CHECK : FOLD, 0));
+}
+
+void SeatedBot::strike(const char *reason) {
+    if (++strikes < HOUSE_BOT_MAX_STRIKES) return;
+    benched = true;
+    LOG_ERROR(LOG_SERVER, "House bot %s %s %d times in a row, it will only check or fold from now on", qPrintable(name), reason, strikes);
+}
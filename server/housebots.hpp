@@ -0,0 +1,75 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include "botapi.hpp"
+using namespace std;
+
+// Time a house bot gets for each decision unless the server is told otherwise
+#define HOUSE_BOT_BUDGET_MS 5
+// Decisions in a row a house bot may spoil (late, not allowed, or throwing) before it
+// is benched and only checks or folds for the rest of its time at the table
+#define HOUSE_BOT_MAX_STRIKES 3
+// How long a removed bot's thread is given to stop, a bot stuck for longer is left running
+#define HOUSE_BOT_STOP_MS 1000
+
+// A bot library. Each is loaded once however many seats it plays, and stays loaded until
+// exit since the bots it created run its code
+class BotLibrary {
+public:
+    // Returns nullptr and sets error if path is not a bot library built for this HOUSE_BOT_API_VERSION
+    static const BotLibrary *load(const QString &path, QString *error);
+
+    HouseBot *create(const QString &config) const;
+    QString get_name() const;
+
+private:
+    QString name;
+    CreateHouseBot factory = nullptr;
+};
+
+struct BotReplies;
+
+// A house bot in its seat. The bot runs on a thread of its own and the table never waits
+// for it: a decision not back by its deadline is played as a check or fold, and the answer
+// is thrown away when it does come. Calls into the bot are queued to its thread in order
+class SeatedBot {
+public:
+    // Answers are delivered through context, which has to outlive the seat
+    SeatedBot(HouseBot *new_bot, const QString &new_name, int new_seat, QObject *context);
+    ~SeatedBot();
+
+    QString get_name() const;
+    int get_seat() const;
+
+    void hand_started(const BotView &view);
+    void action_made(const BotView &view, int actor, const Action &action);
+    // Calls answered once on context's thread with an action the view allows, the bot's own
+    // if it came back within budgetNs. Straight away if the bot is benched or still stuck
+    void decide(const BotView &view, uint64_t budgetNs, function<void(const Action&)> answered);
+
+private:
+    void notify(function<void(HouseBot*)> call, const char *when);
+    // From the bot's thread once decide() returns, and from the deadline
+    void answer(const Action &action, bool threw, uint64_t used);
+    void deadline_passed(quint64 decision);
+    void strike(const char *reason);
+
+    HouseBot *bot;
+    QString name;
+    int seat;
+    QThread *thread;
+    QObject *runner; // lives on thread, calls into the bot are queued to it
+    shared_ptr<BotReplies> replies;
+
+    quint64 decisions = 0;                  // numbers decisions so a deadline can tell which it was for
+    function<void(const Action&)> answered; // for the decision still waiting for an answer
+    LegalActions legal = {0, 0, 0, 0};
+    bool deciding = false;                  // the bot's thread has yet to come back from decide()
+    int strikes = 0;                        // spoilt decisions in a row
+    bool benched = false;                   // out of strikes, the bot is no longer asked
+};
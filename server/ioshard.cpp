@@ -0,0 +1,208 @@
+#include "ioshard.hpp"
+#include "messages.hpp"
+#include "logger.hpp"
+
+IoShard::IoShard(int new_index, const QVector<QAtomicInt*> &new_spectatorCounts)
+    : index(new_index)
+    , spectatorCounts(new_spectatorCounts) {
+    ioThread.setObjectName(QStringLiteral("io-%1").arg(index));
+    moveToThread(&ioThread);
+    ioThread.start();
+    QMetaObject::invokeMethod(this, [this]() { Trace::setThreadName("io-" + to_string(index)); }, Qt::QueuedConnection);
+}
+
+IoShard::~IoShard() {
+    // Sockets have to be destroyed on the thread that owns them, then the shard
+    // hands itself back to the deleting thread before its own thread stops
+    QThread *owner = QThread::currentThread();
+    QMetaObject::invokeMethod(this, [this, owner]() {
+        qDeleteAll(workers);
+        workers.clear();
+        moveToThread(owner);
+    }, Qt::BlockingQueuedConnection);
+    ioThread.quit();
+    ioThread.wait();
+}
+
+int IoShard::get_index() const {
+    return index;
+}
+
+int IoShard::get_connection_count() const {
+    return connectionCount.loadRelaxed();
+}
+
+void IoShard::addConnection(qintptr socketDescriptor) {
+    ServerWorker *worker = new ServerWorker();
+    if (!worker->setSocketDescriptor(socketDescriptor)) {
+        delete worker;
+        return;
+    }
+    adopt(worker);
+}
+
+void IoShard::addLocalConnection(qintptr socketDescriptor) {
+    ServerWorker *worker = new ServerWorker();
+    if (!worker->setLocalDescriptor(socketDescriptor)) {
+        LOG_WARN(LOG_NET, "Unable to set up shared memory for a local connection on I/O thread %d", index);
+        delete worker;
+        return;
+    }
+    adopt(worker);
+}
+
+void IoShard::adopt(ServerWorker *worker) {
+
+    // Forward through the shard so the table thread sees messages in the order they were read
+    // Spectator requests are answered here and never reach it
+    connect(worker, &ServerWorker::messageReceived, this, [this, worker](const AnyMessage &message) {
+        if (!handleSpectator(worker, message)) emit messageReceived(worker, message, Metrics::now());
+    });
+    connect(worker, &ServerWorker::snapshotNeeded, this, [this, worker]() {
+        auto it = watching.constFind(worker);
+        if (it == watching.cend()) {
+            emit snapshotNeeded(worker);
+            return;
+        }
+        SpectatorFeed &feed = feeds[it.value()];
+        if (feed.hasState) sendSnapshot(feed, worker);
+    });
+    connect(worker, &ServerWorker::disconnectedFromClient, this, [this, worker]() { emit connectionClosed(worker); });
+
+    workers.insert(worker);
+    connectionCount.fetchAndAddRelaxed(1);
+    Metrics::add(COUNTER_CONNECTIONS_OPENED);
+    emit connectionOpened(worker);
+}
+
+void IoShard::closeConnection(ServerWorker *worker) {
+    // The table thread calls this once it has forgotten the worker, nothing else can reach it after
+    if (!workers.remove(worker)) return;
+    unwatch(worker);
+    connectionCount.fetchAndAddRelaxed(-1);
+    Metrics::add(COUNTER_CONNECTIONS_CLOSED);
+    worker->deleteLater();
+}
+
+void IoShard::disconnectAll() {
+    for (ServerWorker *worker : workers) worker->disconnectFromClient();
+}
+
+void IoShard::sendFrame(ServerWorker *worker, const QByteArray &frame, FrameKind kind) {
+    sendFrame(QVector<ServerWorker*>{worker}, frame, kind);
+}
+
+void IoShard::sendFrame(const QVector<ServerWorker*> &recipients, const QByteArray &frame, FrameKind kind) {
+    // One queued call per shard rather than one per socket
+    QMetaObject::invokeMethod(this, [this, recipients, frame, kind]() { write(recipients, frame, kind); }, Qt::QueuedConnection);
+}
+
+void IoShard::write(const QVector<ServerWorker*> &recipients, const QByteArray &frame, FrameKind kind) {
+    for (ServerWorker *worker : recipients) {
+        if (workers.contains(worker)) worker->sendFrame(frame, kind);
+    }
+}
+
+bool IoShard::handleSpectator(ServerWorker *worker, const AnyMessage &message) {
+
+    const WireProtocol::MessageId id = WireProtocol::messageId(message);
+
+    if (const WatchTableMessage *watchTable = get_if<WatchTableMessage>(&message)) {
+        const int tableId = watchTable->table_id;
+        if (tableId < 0 || tableId >= spectatorCounts.size()) {
+            ErrorMessage error;
+            error.message = QStringLiteral("Table %1 does not exist").arg(tableId);
+            worker->sendMessage(error);
+            return true;
+        }
+        watch(worker, tableId);
+        return true;
+    }
+    if (id == WireProtocol::UNWATCH_TABLE) {
+        unwatch(worker);
+        return true;
+    }
+
+    // A spectator resyncing after a gap gets the snapshot this shard already holds
+    if (id == WireProtocol::REQUEST_STATE && watching.contains(worker)) {
+        SpectatorFeed &feed = feeds[watching.value(worker)];
+        if (feed.hasState) sendSnapshot(feed, worker);
+        return true;
+    }
+
+    return false;
+}
+
+void IoShard::watch(ServerWorker *worker, int tableId) {
+
+    if (watching.value(worker, -1) == tableId) return;
+    unwatch(worker);
+
+    SpectatorFeed &feed = feeds[tableId];
+    feed.watchers.append(worker);
+    watching.insert(worker, tableId);
+    spectatorCounts[tableId]->fetchAndAddRelaxed(1);
+
+    // The first spectator asks the table for its state, later ones are served from it
+    if (feed.hasState) {
+        sendSnapshot(feed, worker);
+    } else if (feed.watchers.size() == 1) {
+        emit feedRequested(tableId);
+    }
+    LOG_DEBUG(LOG_NET, "Spectator watching table %d on I/O thread %d, %d here", tableId, index, int(feed.watchers.size()));
+}
+
+void IoShard::unwatch(ServerWorker *worker) {
+
+    auto it = watching.find(worker);
+    if (it == watching.end()) return;
+    const int tableId = it.value();
+    watching.erase(it);
+    spectatorCounts[tableId]->fetchAndAddRelaxed(-1);
+
+    // The table stops publishing once nobody watches, so an empty feed's state would go stale
+    SpectatorFeed &feed = feeds[tableId];
+    feed.watchers.removeOne(worker);
+    if (feed.watchers.isEmpty()) feeds.remove(tableId);
+}
+
+void IoShard::sendSnapshot(SpectatorFeed &feed, ServerWorker *worker) {
+    const int wireVersion = worker->get_wire_version();
+    QByteArray &frame = feed.snapshotFrames[wireVersion];
+    if (frame.isNull()) {
+        frame = encodeFrame(feed.state.toMessage(feed.version), wireVersion);
+    }
+    worker->sendFrame(frame, FRAME_SNAPSHOT);
+}
+
+void IoShard::publishEvent(int tableId, const QVector<QByteArray> &frames) {
+    QMetaObject::invokeMethod(this, [this, tableId, frames]() {
+        auto it = feeds.find(tableId);
+        if (it == feeds.end()) return;
+        for (ServerWorker *worker : it->watchers) worker->sendFrame(frames[worker->get_wire_version()]);
+    }, Qt::QueuedConnection);
+}
+
+void IoShard::publishState(int tableId, const PublicState &state, quint32 version, const QVector<QByteArray> &deltaFrames) {
+    QMetaObject::invokeMethod(this, [this, tableId, state, version, deltaFrames]() {
+        auto it = feeds.find(tableId);
+        if (it == feeds.end()) return;
+        SpectatorFeed &feed = it.value();
+        // A state request answered after a delta already brought the feed up to date
+        if (feed.hasState && deltaFrames.isEmpty()) return;
+        const bool hadState = feed.hasState;
+        feed.hasState = true;
+        feed.state = state;
+        feed.version = version;
+        for (QByteArray &frame : feed.snapshotFrames) frame.clear();
+
+        // Spectators still waiting for their first state get the whole thing instead of the delta
+        for (ServerWorker *worker : feed.watchers) {
+            if (hadState && !deltaFrames.isEmpty()) {
+                worker->sendFrame(deltaFrames[worker->get_wire_version()], FRAME_DELTA);
+            } else {
+                sendSnapshot(feed, worker);
+            }
+        }
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QByteArray>
+#include <QVector>
+#include <QSet>
+#include <QHash>
+#include "serverworker.hpp"
+#include "publicstate.hpp"
+#include "wireprotocol.hpp"
+using namespace std;
+
+// A thread that owns a share of the client sockets. Reading, framing and decoding
+// happen here, the table thread only sees decoded messages and hands back encoded frames.
+class IoShard : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(IoShard)
+public:
+    // spectatorCounts has one counter per table, the shard keeps them up to date with
+    // its watchers so the table thread can skip publishing to tables nobody watches
+    IoShard(int index, const QVector<QAtomicInt*> &spectatorCounts);
+    ~IoShard();
+
+    int get_index() const;
+    int get_connection_count() const;
+
+    // Safe to call from any thread, the write happens on the shard thread
+    void sendFrame(ServerWorker *worker, const QByteArray &frame, FrameKind kind = FRAME_MESSAGE);
+    void sendFrame(const QVector<ServerWorker*> &workers, const QByteArray &frame, FrameKind kind = FRAME_MESSAGE);
+
+    // Spectator feeds, also safe to call from any thread. frames holds the message encoded
+    // for every wire version, and each spectator of the table is sent the one it speaks.
+    // publishState also replaces the state new spectators are given, a delta (if any)
+    // goes out to the spectators that already have the previous state
+    void publishEvent(int tableId, const QVector<QByteArray> &frames);
+    void publishState(int tableId, const PublicState &state, quint32 version, const QVector<QByteArray> &deltaFrames);
+
+public slots:
+    void addConnection(qintptr socketDescriptor);
+    // A connection from the local server, see ShmChannel
+    void addLocalConnection(qintptr socketDescriptor);
+    void closeConnection(ServerWorker *worker);
+    void disconnectAll();
+
+signals:
+    void connectionOpened(ServerWorker *worker);
+    // decodedAt is the Metrics::now() time the message was decoded
+    void messageReceived(ServerWorker *worker, const AnyMessage &message, quint64 decodedAt);
+    void connectionClosed(ServerWorker *worker);
+    // The shard has new spectators for a table and needs its current state, see publishState
+    void feedRequested(int tableId);
+    // A seated client had state deltas dropped and needs a GAME_STATE, spectators are
+    // resynced from their feed without asking
+    void snapshotNeeded(ServerWorker *worker);
+
+private:
+    QThread ioThread;
+    int index;
+    QSet<ServerWorker*> workers; // only touched on the shard thread
+    QAtomicInt connectionCount;
+
+    // Spectators of one table on this shard. Everything they need is published here,
+    // so watching never involves the table thread beyond the first state request
+    struct SpectatorFeed {
+        QVector<ServerWorker*> watchers;
+        bool hasState = false; // false until the table answers feedRequested
+        PublicState state;
+        quint32 version = 0;
+        QByteArray snapshotFrames[WIRE_PROTOCOL_VERSION + 1]; // GAME_STATE for version, built on first use
+    };
+    QVector<QAtomicInt*> spectatorCounts;
+    QHash<int, SpectatorFeed> feeds;     // by table id
+    QHash<ServerWorker*, int> watching;  // table each spectator watches
+
+    void adopt(ServerWorker *worker);
+    void write(const QVector<ServerWorker*> &recipients, const QByteArray &frame, FrameKind kind);
+    bool handleSpectator(ServerWorker *worker, const AnyMessage &message);
+    void watch(ServerWorker *worker, int tableId);
+    void unwatch(ServerWorker *worker);
+    void sendSnapshot(SpectatorFeed &feed, ServerWorker *worker);
+};
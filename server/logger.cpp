@@ -0,0 +1,184 @@
+#include "logger.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+atomic<int> Logger::minimum_level(LOG_MIN_LEVEL);
+atomic<uint32_t> Logger::sample_rate[LOG_CATEGORY_COUNT] = {};
+atomic<uint32_t> Logger::sample_counter[LOG_CATEGORY_COUNT] = {};
+
+namespace {
+
+const char* const level_names[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+const char* const category_names[LOG_CATEGORY_COUNT] = {"net", "protocol", "server", "engine", "game"};
+
+// Single producer (the owning thread), single consumer (the drain thread)
+struct LogRing {
+    static const uint32_t CAPACITY = 512; // power of two
+    LogRecord records[CAPACITY];
+    atomic<uint32_t> head{0};
+    atomic<uint32_t> tail{0};
+    atomic<bool> retired{false}; // owning thread has exited, free once drained
+};
+
+mutex rings_mutex; // guards rings, only taken when a thread logs for the first time and by the drain thread
+vector<LogRing*> rings;
+atomic<uint16_t> next_thread_id{0};
+atomic<uint64_t> dropped_count{0};
+
+mutex drain_mutex;
+condition_variable drain_wakeup;
+thread drain_thread;
+bool drain_stop = false;
+FILE* drain_out = nullptr;
+function<void(const string&)> drain_listener;
+
+struct ThreadRing {
+    LogRing* ring;
+    uint16_t id;
+    ThreadRing() : ring(new LogRing()), id(next_thread_id++) {
+        lock_guard<mutex> lock(rings_mutex);
+        rings.push_back(ring);
+    }
+    ~ThreadRing() { ring->retired.store(true, memory_order_release); }
+};
+
+ThreadRing& thread_ring() {
+    thread_local ThreadRing local;
+    return local;
+}
+
+void format_record(const LogRecord& record, string& out) {
+    time_t seconds = time_t(record.timestamp_us / 1000000);
+    tm utc;
+#if defined(_MSC_VER)
+    gmtime_s(&utc, &seconds);
+#else
+    gmtime_r(&seconds, &utc);
+#endif
+    char prefix[64];
+    size_t length = strftime(prefix, sizeof(prefix), "%Y-%m-%dT%H:%M:%S", &utc);
+    snprintf(prefix + length, sizeof(prefix) - length, ".%06dZ", int(record.timestamp_us % 1000000));
+    out += prefix;
+    out += ' ';
+    out += level_names[record.level];
+    out += ' ';
+    out += category_names[record.category];
+    out += " [";
+    out += to_string(record.thread);
+    out += "] ";
+    out += record.message;
+    out += '\n';
+}
+
+// Empties every ring into one batch, returns false if there was nothing to write
+bool drain_rings(string& batch) {
+    vector<LogRing*> retired;
+    {
+        lock_guard<mutex> lock(rings_mutex);
+        for (size_t i = 0; i < rings.size();) {
+            LogRing* ring = rings[i];
+            bool was_retired = ring->retired.load(memory_order_acquire);
+            uint32_t tail = ring->tail.load(memory_order_relaxed);
+            uint32_t head = ring->head.load(memory_order_acquire);
+            for (; tail != head; ++tail) format_record(ring->records[tail & (LogRing::CAPACITY - 1)], batch);
+            ring->tail.store(tail, memory_order_release);
+            if (was_retired) {
+                retired.push_back(ring);
+                rings[i] = rings.back();
+                rings.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+    for (LogRing* ring : retired) delete ring;
+    return !batch.empty();
+}
+
+void flush_batch(const string& batch) {
+    if (drain_out) {
+        fwrite(batch.data(), 1, batch.size(), drain_out);
+        fflush(drain_out);
+    }
+    if (drain_listener) drain_listener(batch);
+}
+
+void drain_loop() {
+    string batch;
+    unique_lock<mutex> lock(drain_mutex);
+    while (!drain_stop) {
+        drain_wakeup.wait_for(lock, chrono::milliseconds(20));
+        batch.clear();
+        if (drain_rings(batch)) flush_batch(batch);
+    }
+    batch.clear();
+    if (drain_rings(batch)) flush_batch(batch);
+}
+
+}
+
+void Logger::start(FILE* out) {
+    stop();
+    lock_guard<mutex> lock(drain_mutex);
+    drain_out = out;
+    drain_stop = false;
+    drain_thread = thread(drain_loop);
+}
+
+void Logger::stop() {
+    {
+        lock_guard<mutex> lock(drain_mutex);
+        if (!drain_thread.joinable()) return;
+        drain_stop = true;
+    }
+    drain_wakeup.notify_one();
+    drain_thread.join();
+}
+
+void Logger::setListener(function<void(const string&)> listener) {
+    lock_guard<mutex> lock(drain_mutex);
+    drain_listener = move(listener);
+}
+
+void Logger::setLevel(int level) {
+    minimum_level.store(level, memory_order_relaxed);
+}
+
+void Logger::setSampleRate(LogCategory category, uint32_t rate) {
+    sample_rate[category].store(rate, memory_order_relaxed);
+}
+
+uint64_t Logger::dropped() {
+    return dropped_count.load(memory_order_relaxed);
+}
+
+void Logger::write(int level, LogCategory category, const char* format, ...) {
+
+    ThreadRing& local = thread_ring();
+    LogRing* ring = local.ring;
+
+    uint32_t head = ring->head.load(memory_order_relaxed);
+    if (head - ring->tail.load(memory_order_acquire) >= LogRing::CAPACITY) {
+        dropped_count.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    LogRecord& record = ring->records[head & (LogRing::CAPACITY - 1)];
+    record.timestamp_us = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    record.level = uint8_t(level);
+    record.category = uint8_t(category);
+    record.thread = local.id;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(record.message, LOG_MESSAGE_SIZE, format, args);
+    va_end(args);
+
+    ring->head.store(head + 1, memory_order_release);
+}
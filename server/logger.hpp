@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+using namespace std;
+
+// Plain defines rather than an enum so that LOG_MIN_LEVEL can be compared in #if
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_OFF 4
+
+enum LogCategory { LOG_NET, LOG_PROTOCOL, LOG_SERVER, LOG_ENGINE, LOG_GAME, LOG_CATEGORY_COUNT };
+
+// Levels below this are compiled out completely, arguments and all
+#ifndef LOG_MIN_LEVEL
+#ifdef QT_NO_DEBUG
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+#define LOG_MESSAGE_SIZE 232
+
+struct LogRecord {
+    int64_t timestamp_us; // microseconds since the epoch
+    uint8_t level;
+    uint8_t category;
+    uint16_t thread;
+    char message[LOG_MESSAGE_SIZE];
+};
+
+// Each thread formats into its own lock-free ring, a background thread drains every ring
+// and writes the lines out, so logging never blocks on I/O or on another thread.
+// Records are dropped (and counted) rather than waiting when a ring is full.
+class Logger {
+public:
+    // Starts the drain thread writing to out, which stays owned by the caller
+    static void start(FILE* out);
+    // Drains whatever is left and stops the drain thread
+    static void stop();
+
+    // Called on the drain thread with every batch of formatted lines, for example to feed a log window
+    static void setListener(function<void(const string& lines)> listener);
+
+    static void setLevel(int level);
+    // Keep one in every rate debug/info records of a category, 1 keeps everything.
+    // Warnings and errors are never sampled
+    static void setSampleRate(LogCategory category, uint32_t rate);
+
+    static bool enabled(int level, LogCategory category) {
+        if (level < minimum_level.load(memory_order_relaxed)) return false;
+        if (level >= LOG_LEVEL_WARN) return true;
+        uint32_t rate = sample_rate[category].load(memory_order_relaxed);
+        return rate <= 1 || sample_counter[category].fetch_add(1, memory_order_relaxed) % rate == 0;
+    }
+
+#if defined(__GNUC__)
+    __attribute__((format(printf, 3, 4)))
+#endif
+    static void write(int level, LogCategory category, const char* format, ...);
+
+    static uint64_t dropped();
+
+private:
+    static atomic<int> minimum_level;
+    static atomic<uint32_t> sample_rate[LOG_CATEGORY_COUNT];
+    static atomic<uint32_t> sample_counter[LOG_CATEGORY_COUNT];
+};
+
+// For debug output that takes work to build, check this once and then call Logger::write
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG_ENABLED(category) Logger::enabled(LOG_LEVEL_DEBUG, category)
+#else
+#define LOG_DEBUG_ENABLED(category) false
+#endif
+
+#define LOG_AT(level, category, ...) \
+    do { if (Logger::enabled(level, category)) Logger::write(level, category, __VA_ARGS__); } while (0)
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(category, ...) LOG_AT(LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+#else
+#define LOG_DEBUG(category, ...) do {} while (0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(category, ...) LOG_AT(LOG_LEVEL_INFO, category, __VA_ARGS__)
+#else
+#define LOG_INFO(category, ...) do {} while (0)
+#endif
+
+#define LOG_WARN(category, ...) LOG_AT(LOG_LEVEL_WARN, category, __VA_ARGS__)
+#define LOG_ERROR(category, ...) LOG_AT(LOG_LEVEL_ERROR, category, __VA_ARGS__)
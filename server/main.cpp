@@ -5,8 +5,15 @@
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
-    ServerWindow w;
-    w.show();
+    Logger::start(stderr);
 
-    return a.exec();
+    int result;
+    {
+        ServerWindow w;
+        w.show();
+        result = a.exec();
+    }
+
+    Logger::stop();
+    return result;
 }
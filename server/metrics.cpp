@@ -0,0 +1,173 @@
+#include "metrics.hpp"
+
+#include <cstdarg>
+#include <cstdio>
+
+Histogram Metrics::stages[STAGE_COUNT];
+Histogram Metrics::messages[METRIC_MESSAGE_TYPES];
+atomic<uint64_t> Metrics::counters[COUNTER_COUNT] = {};
+
+namespace {
+
+const char* const stage_names[STAGE_COUNT] = {
+    "decode", "dispatch", "engine_queue", "engine_apply", "engine_tick", "encode", "write_queue", "write", "bot_decide"
+};
+const char* const counter_names[COUNTER_COUNT] = {
+    "frames_in", "bytes_in", "decode_errors", "frames_out", "bytes_out", "writes",
+    "frames_dropped", "slow_clients", "connections_opened", "connections_closed",
+    "frames_oversized", "frames_rejected", "rate_limited", "bot_overruns"
+};
+string message_names[METRIC_MESSAGE_TYPES];
+
+// Prometheus buckets are every power of two ns in this range, 256ns to about 17s
+const int exported_min_bits = 8;
+const int exported_max_bits = 34;
+
+int highest_bit(uint64_t value) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) bit++;
+    return bit;
+#endif
+}
+
+void append_format(string& out, const char* format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+;
+void append_format(string& out, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length > 0) out.append(line, size_t(length) < sizeof(line) ? size_t(length) : sizeof(line) - 1);
+}
+
+void append_histogram(string& out, const char* name, const char* label, const string& value, const Histogram& histogram) {
+    for (int bits = exported_min_bits; bits <= exported_max_bits; ++bits) {
+        append_format(out, "%s_bucket{%s=\"%s\",le=\"%.9g\"} %llu\n", name, label, value.c_str(),
+                      double(uint64_t(1) << bits) / 1e9, (unsigned long long)histogram.countBelow(uint64_t(1) << bits));
+    }
+    const unsigned long long count = histogram.count();
+    append_format(out, "%s_bucket{%s=\"%s\",le=\"+Inf\"} %llu\n", name, label, value.c_str(), count);
+    append_format(out, "%s_sum{%s=\"%s\"} %.9g\n", name, label, value.c_str(), double(histogram.sum()) / 1e9);
+    append_format(out, "%s_count{%s=\"%s\"} %llu\n", name, label, value.c_str(), count);
+}
+
+void append_quantiles(string& out, const string& name, const Histogram& histogram) {
+    append_format(out, "%-20s n=%-10llu p50=%.1fus p99=%.1fus p999=%.1fus\n", name.c_str(), (unsigned long long)histogram.count(),
+                  histogram.percentile(50) / 1e3, histogram.percentile(99) / 1e3, histogram.percentile(99.9) / 1e3);
+}
+
+}
+
+int Histogram::bucketOf(uint64_t value) {
+    const uint64_t sub_buckets = uint64_t(1) << HISTOGRAM_SUB_BITS;
+    if (value < sub_buckets) return int(value);
+    if (value >> HISTOGRAM_MAX_BITS) return HISTOGRAM_BUCKETS - 1;
+    const int shift = highest_bit(value) - HISTOGRAM_SUB_BITS;
+    return int((uint64_t(shift + 1) << HISTOGRAM_SUB_BITS) + ((value >> shift) - sub_buckets));
+}
+
+uint64_t Histogram::bucketUpper(int bucket) {
+    const int sub_buckets = 1 << HISTOGRAM_SUB_BITS;
+    if (bucket < sub_buckets) return uint64_t(bucket);
+    const int shift = (bucket >> HISTOGRAM_SUB_BITS) - 1;
+    const uint64_t top = uint64_t(bucket & (sub_buckets - 1)) + sub_buckets;
+    return ((top + 1) << shift) - 1;
+}
+
+void Histogram::record(uint64_t value) {
+    buckets[bucketOf(value)].fetch_add(1, memory_order_relaxed);
+    total.fetch_add(1, memory_order_relaxed);
+    total_sum.fetch_add(value, memory_order_relaxed);
+}
+
+uint64_t Histogram::count() const {
+    return total.load(memory_order_relaxed);
+}
+
+uint64_t Histogram::sum() const {
+    return total_sum.load(memory_order_relaxed);
+}
+
+uint64_t Histogram::percentile(double percentile) const {
+    // Buckets are read one at a time while other threads record, which is close enough for reporting
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t samples = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        counts[i] = buckets[i].load(memory_order_relaxed);
+        samples += counts[i];
+    }
+    if (samples == 0) return 0;
+
+    uint64_t rank = uint64_t(percentile / 100.0 * double(samples) + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > samples) rank = samples;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return bucketUpper(i);
+    }
+    return bucketUpper(HISTOGRAM_BUCKETS - 1);
+}
+
+uint64_t Histogram::countBelow(uint64_t bound) const {
+    if (bound >> HISTOGRAM_MAX_BITS) return count();
+    uint64_t below = 0;
+    for (int i = 0, end = bucketOf(bound); i < end; ++i) below += buckets[i].load(memory_order_relaxed);
+    return below;
+}
+
+void Metrics::recordMessage(int type, uint64_t nanoseconds) {
+    if (type < 0 || type >= METRIC_MESSAGE_TYPES) type = 0;
+    messages[type].record(nanoseconds);
+}
+
+void Metrics::setMessageName(int type, const string& name) {
+    if (type >= 0 && type < METRIC_MESSAGE_TYPES) message_names[type] = name;
+}
+
+string Metrics::prometheus() {
+    string out;
+    out.reserve(64 * 1024);
+
+    out += "# HELP poker_stage_seconds Time spent in each stage between reading a frame and writing the results\n";
+    out += "# TYPE poker_stage_seconds histogram\n";
+    for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+        append_histogram(out, "poker_stage_seconds", "stage", stage_names[stage], stages[stage]);
+    }
+
+    out += "# HELP poker_message_seconds Time the table thread spent handling each received message type\n";
+    out += "# TYPE poker_message_seconds histogram\n";
+    for (int type = 0; type < METRIC_MESSAGE_TYPES; ++type) {
+        if (messages[type].count() == 0) continue;
+        append_histogram(out, "poker_message_seconds", "type", message_names[type].empty() ? string("other") : message_names[type], messages[type]);
+    }
+
+    for (int counter = 0; counter < COUNTER_COUNT; ++counter) {
+        append_format(out, "# TYPE poker_%s_total counter\npoker_%s_total %llu\n", counter_names[counter], counter_names[counter],
+                      (unsigned long long)counters[counter].load(memory_order_relaxed));
+    }
+    return out;
+}
+
+string Metrics::summary() {
+    string out;
+    for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+        if (stages[stage].count()) append_quantiles(out, stage_names[stage], stages[stage]);
+    }
+    for (int type = 0; type < METRIC_MESSAGE_TYPES; ++type) {
+        if (messages[type].count()) append_quantiles(out, message_names[type].empty() ? string("other") : message_names[type], messages[type]);
+    }
+    // A few counters per line so that each line fits in a log record
+    for (int counter = 0; counter < COUNTER_COUNT; ++counter) {
+        const bool last_on_line = counter % 5 == 4 || counter == COUNTER_COUNT - 1;
+        append_format(out, "%s=%llu%c", counter_names[counter], (unsigned long long)counters[counter].load(memory_order_relaxed), last_on_line ? '\n' : ' ');
+    }
+    return out;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+using namespace std;
+
+// Histograms keep 2^HISTOGRAM_SUB_BITS buckets per power of two, so any quantile read back
+// is within 1/16th of the real value, for values up to 2^HISTOGRAM_MAX_BITS (about 18 minutes in ns)
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+// Message types are the WireProtocol message ids, 0 collects the ones without an id
+#define METRIC_MESSAGE_TYPES 32
+
+// Where time goes between a frame arriving and the resulting frames leaving
+enum MetricStage {
+    STAGE_DECODE,        // frame to message, on the I/O thread
+    STAGE_DISPATCH,      // decoded on the I/O thread to handled on the table thread
+    STAGE_ENGINE_QUEUE,  // action accepted to applied by the next engine tick
+    STAGE_ENGINE_APPLY,  // applying an action to the game
+    STAGE_ENGINE_TICK,   // one engine step
+    STAGE_ENCODE,        // message to frame
+    STAGE_WRITE_QUEUE,   // frame queued for a socket to handed to it
+    STAGE_WRITE,         // handing a batch to the socket
+    STAGE_BOT_DECIDE,    // house bot asked to answered, on the bot's thread
+    STAGE_COUNT
+};
+
+enum MetricCounter {
+    COUNTER_FRAMES_IN,
+    COUNTER_BYTES_IN,
+    COUNTER_DECODE_ERRORS,
+    COUNTER_FRAMES_OUT,
+    COUNTER_BYTES_OUT,
+    COUNTER_WRITES,
+    COUNTER_FRAMES_DROPPED,   // state frames shed for slow clients
+    COUNTER_SLOW_CLIENTS,     // clients disconnected for not reading
+    COUNTER_CONNECTIONS_OPENED,
+    COUNTER_CONNECTIONS_CLOSED,
+    COUNTER_FRAMES_OVERSIZED, // connections aborted for announcing a frame over MAX_FRAME_BYTES
+    COUNTER_FRAMES_REJECTED,  // frames of a type the connection may not send, dropped undecoded where possible
+    COUNTER_RATE_LIMITED,     // times a connection's reads were paused for sending too fast
+    COUNTER_BOT_OVERRUNS,     // house bot decisions played as a check or fold for missing their deadline
+    COUNTER_COUNT
+};
+
+// Lock-free log-linear histogram, recording is one relaxed increment per field so any thread can record
+class Histogram {
+public:
+    void record(uint64_t value);
+
+    uint64_t count() const;
+    uint64_t sum() const;
+    // Upper bound of the bucket holding the given percentile (0-100), 0 when empty
+    uint64_t percentile(double percentile) const;
+    // Values recorded below bound, exact when bound is a power of two
+    uint64_t countBelow(uint64_t bound) const;
+
+private:
+    static int bucketOf(uint64_t value);
+    static uint64_t bucketUpper(int bucket);
+
+    atomic<uint64_t> buckets[HISTOGRAM_BUCKETS] = {};
+    atomic<uint64_t> total{0};
+    atomic<uint64_t> total_sum{0};
+};
+
+// Process wide stage timings, per message type handling times and counters
+class Metrics {
+public:
+    static uint64_t now() {
+        return uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static void record(MetricStage stage, uint64_t nanoseconds) { stages[stage].record(nanoseconds); }
+    static void recordSince(MetricStage stage, uint64_t start) { stages[stage].record(now() - start); }
+    // Time the table thread spent handling one received message
+    static void recordMessage(int type, uint64_t nanoseconds);
+    static void add(MetricCounter counter, uint64_t amount = 1) { counters[counter].fetch_add(amount, memory_order_relaxed); }
+
+    // Label used for a message type in the output, set once at startup
+    static void setMessageName(int type, const string& name);
+
+    // Prometheus text exposition format
+    static string prometheus();
+    // A few lines with the count and p50/p99/p999 of every stage that has samples
+    static string summary();
+
+private:
+    static Histogram stages[STAGE_COUNT];
+    static Histogram messages[METRIC_MESSAGE_TYPES];
+    static atomic<uint64_t> counters[COUNTER_COUNT];
+};
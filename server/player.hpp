@@ -3,16 +3,14 @@
 #include "cards.hpp"
 using namespace std;
 
+// Identity of a seat. Chips and betting status live in the TableState owned by GameState.
 class Player {
 private:
     int playerID;
     string username;
-    int stack;
-    int to_call;
-    bool folded;
     vector<Card> hole_cards;
 public:
-    Player(int newID, string new_username, int init_stack);
+    Player(int newID, string new_username);
 
     // This is synonymous with getting the player's index within game.players
     int get_playerID() const;
@@ -20,20 +18,9 @@ public:
     string get_username() const;
     void set_username(const string &new_username);
 
-    int get_stack() const;
-
-    int bet(int amount);
-    void win(int amount);
-
-    int get_to_call() const;
-    void set_to_call(int new_to_call);
-
-    void fold();
-    bool has_folded() const;
-    void unfold();
-
     void deal_hole_cards(vector<Card> new_hole_cards);
     vector<Card> get_hole_cards() const;
+    void clear_hole_cards();
 
     bool operator==(const Player &other) const;
 };
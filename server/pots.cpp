@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <climits>
+#include "pots.hpp"
+using namespace std;
+
+int build_pots(const TableState& table, Pot pots[MAXPLAYERS]) {
+
+    // Sort the contributing seats once, by how much they put in
+    int order[MAXPLAYERS];
+    int n = 0;
+    for (int i = 0; i < table.num_players; ++i) {
+        if (table.contributed[i] > 0) order[n++] = i;
+    }
+    sort(order, order + n, [&table](int a, int b) { return table.contributed[a] < table.contributed[b]; });
+
+    // eligible_from[k] is the seats still in the hand among order[k..n)
+    SeatMask eligible_from[MAXPLAYERS + 1];
+    eligible_from[n] = 0;
+    for (int k = n - 1; k >= 0; --k) {
+        eligible_from[k] = eligible_from[k + 1] | (table.active_mask & seat_bit(order[k]));
+    }
+
+    // Each new contribution level adds a layer that everyone at or above it paid into
+    int num_pots = 0;
+    int prev_level = 0;
+    for (int k = 0; k < n; ++k) {
+        int level = table.contributed[order[k]];
+        if (level == prev_level) continue;
+
+        int amount = (level - prev_level) * (n - k);
+        SeatMask eligible = eligible_from[k];
+        prev_level = level;
+
+        // Layers that only differ by folded seats belong to the same pot
+        if (num_pots > 0 && (eligible == pots[num_pots - 1].eligible || eligible == 0)) {
+            pots[num_pots - 1].amount += amount;
+        } else {
+            pots[num_pots++] = {amount, eligible, 0};
+        }
+    }
+    return num_pots;
+}
+
+void settle_pots(const TableState& table, Pot pots[], int num_pots, const int rank[MAXPLAYERS], int payouts[MAXPLAYERS]) {
+
+    for (int i = 0; i < MAXPLAYERS; ++i) payouts[i] = 0;
+
+    // Each pot's eligible seats contain those of the pots after it, so walking from the
+    // last side pot back to the main pot only ever adds contenders
+    int best_rank = INT_MAX;
+    SeatMask winners = 0;
+    SeatMask seen = 0;
+    for (int p = num_pots - 1; p >= 0; --p) {
+        for (SeatMask added = pots[p].eligible & ~seen; added; added &= added - 1) {
+            int index = lowest_seat(added);
+            if (rank[index] < best_rank) {
+                best_rank = rank[index];
+                winners = seat_bit(index);
+            } else if (rank[index] == best_rank) {
+                winners |= seat_bit(index);
+            }
+        }
+        seen |= pots[p].eligible;
+        pots[p].winners = winners;
+        if (!winners) continue;
+
+        int num_winners = seat_count(winners);
+        int share = pots[p].amount / num_winners;
+        for (SeatMask seats = winners; seats; seats &= seats - 1) payouts[lowest_seat(seats)] += share;
+
+        int seat = table.dealer_index;
+        for (int odd_chips = pots[p].amount % num_winners; odd_chips > 0; --odd_chips) {
+            seat = table.next_in(winners, seat);
+            payouts[seat]++;
+        }
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "tablestate.hpp"
+using namespace std;
+
+struct Pot {
+    int amount;
+    SeatMask eligible; // seats still in the hand that put in enough to win this pot
+    SeatMask winners;  // filled in by settle_pots
+};
+
+// Splits the chips each seat has contributed this hand into the main pot followed by
+// the side pots, in order of increasing contribution. Returns the number of pots written.
+int build_pots(const TableState& table, Pot pots[MAXPLAYERS]);
+
+// Awards each pot to its best ranked eligible seats, where a lower rank is a better hand
+// and equal ranks split. The total won by each seat is written to payouts. Odd chips
+// go one at a time to the winners closest to the left of the dealer.
+void settle_pots(const TableState& table, Pot pots[], int num_pots, const int rank[MAXPLAYERS], int payouts[MAXPLAYERS]);
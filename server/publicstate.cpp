@@ -0,0 +1,78 @@
+#include "publicstate.hpp"
+#include "engine.hpp"
+
+
+PublicState PublicState::capture(Engine &engine) {
+
+    PublicState state;
+    const bool started = engine.get_state() != IDLE;
+
+    // Look the button up once rather than comparing every player against it
+    int dealer = -1, sb = -1, bb = -1;
+    if (started) {
+        dealer = engine.get_dealer().get_playerID();
+        sb = engine.get_sb().get_playerID();
+        bb = engine.get_bb().get_playerID();
+    }
+
+    for (const Player &player : engine.get_players()) {
+        if (!engine.is_seated(player.get_playerID())) continue;
+        PlayerSeat seat;
+        seat.player_id = player.get_playerID();
+        seat.username = QString::fromStdString(player.get_username());
+        seat.stack = engine.get_stack(seat.player_id);
+        if (seat.player_id == dealer) seat.role = QStringLiteral("D");
+        else if (seat.player_id == sb) seat.role = QStringLiteral("SB");
+        else if (seat.player_id == bb) seat.role = QStringLiteral("BB");
+        else seat.role = QStringLiteral("None");
+        state.seats.append(seat);
+    }
+
+    state.game_no = engine.get_game_no();
+    state.pot = engine.get_pot();
+    for (const Card &card : engine.get_board()) state.board.append(QString::fromStdString(card.to_string()));
+    if (started) {
+        state.current_player = engine.get_current_playerID();
+        state.to_call = engine.get_legal_actions().call_amount;
+    }
+    return state;
+}
+
+GameStateMessage PublicState::toMessage(quint32 version) const {
+
+    GameStateMessage gameState;
+    gameState.version = version;
+    gameState.players = seats;
+    gameState.game_no = game_no;
+    gameState.pot = pot;
+    gameState.board = board;
+    gameState.current_player = current_player;
+    gameState.to_call = to_call;
+    return gameState;
+}
+
+bool PublicState::delta(const PublicState &previous, quint32 version, StateDeltaMessage &delta) const {
+
+    delta = StateDeltaMessage();
+    for (int i = 0; i < seats.size(); ++i) {
+        if (i >= previous.seats.size() || seats[i] != previous.seats[i]) delta.players.append(seats[i]);
+    }
+    bool changed = !delta.players.isEmpty();
+
+    if (game_no != previous.game_no) delta.game_no = game_no;
+    if (pot != previous.pot) delta.pot = pot;
+    if (current_player != previous.current_player) delta.current_player = current_player;
+    if (to_call != previous.to_call) delta.to_call = to_call;
+    changed = changed || delta.game_no || delta.pot || delta.current_player || delta.to_call;
+
+    // The board only grows during a hand, so send the new cards unless it was cleared
+    if (board != previous.board) {
+        bool extends = board.size() > previous.board.size() && board.mid(0, previous.board.size()) == previous.board;
+        delta.board_reset = !extends;
+        delta.board_new = extends ? board.mid(previous.board.size()) : board;
+        changed = true;
+    }
+
+    delta.version = version;
+    return changed;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "messages.hpp"
+
+class Engine;
+
+// What every client at the table can see. The server keeps the last one it pushed
+// so that updates only carry the seats and fields that changed.
+struct PublicState {
+    QVector<PlayerSeat> seats;
+    int game_no = 0;
+    int pot = 0;
+    QStringList board;
+    int current_player = -1;
+    int to_call = 0;
+
+    static PublicState capture(Engine &engine);
+
+    GameStateMessage toMessage(quint32 version) const;
+
+    // Fills in the STATE_DELTA taking a client from previous to this state, false if
+    // nothing changed
+    bool delta(const PublicState &previous, quint32 version, StateDeltaMessage &delta) const;
+};
@@ -1,171 +1,711 @@
 #include "server.hpp"
+#include "wireprotocol.hpp"
 
-Server::Server(QObject *parent) : QTcpServer(parent) {}
+#include <QRandomGenerator>
+#include <QTimer>
 
-void Server::incomingConnection(qintptr socketDescriptor) {
+namespace {
 
-    ServerWorker *worker = new ServerWorker(this);
+// The sequence number of a broadcast that a resuming client needs replayed, nullptr for
+// anything else. State updates are covered by its snapshot instead
+quint32 *eventSeq(AnyMessage &message) {
+    if (PlayerActionMessage *event = get_if<PlayerActionMessage>(&message)) return &event->seq;
+    if (PlayerJoinedMessage *event = get_if<PlayerJoinedMessage>(&message)) return &event->seq;
+    if (PlayerLeftMessage *event = get_if<PlayerLeftMessage>(&message)) return &event->seq;
+    if (RevealCardsMessage *event = get_if<RevealCardsMessage>(&message)) return &event->seq;
+    return nullptr;
+}
 
-    if (!worker->setSocketDescriptor(socketDescriptor)) {
-        worker->deleteLater();
-        return;
+// Engine actions by WireProtocol::Action
+const ActionType action_types[WireProtocol::NUM_ACTIONS] = {FOLD, CALL, RAISE, CHECK};
+
+WireProtocol::Action wireAction(ActionType type) {
+    for (int action = 0; action < WireProtocol::NUM_ACTIONS; ++action) {
+        if (action_types[action] == type) return WireProtocol::Action(action);
     }
+    return WireProtocol::NO_ACTION;
+}
 
-    connect(worker, &ServerWorker::disconnectedFromClient, this, std::bind(&Server::clientDisconnected, this, worker));
-    connect(worker, &ServerWorker::jsonReceived, this, std::bind(&Server::jsonReceived, this, worker, std::placeholders::_1));
-    connect(worker, &ServerWorker::logMessage, this, &Server::logMessage);
+QString newResumeToken() {
+    quint32 words[4];
+    QRandomGenerator::system()->fillRange(words);
+    return QString::fromLatin1(QByteArray(reinterpret_cast<const char*>(words), sizeof(words)).toHex());
+}
+
+}
 
-    clients.append(worker);
-    emit logMessage(QStringLiteral("New client connected"));
+Server::Server(QObject *parent, int ioThreads, int numTables)
+    : QTcpServer(parent)
+    , localServer(this)
+    , clockTimer(this) {
+
+    qRegisterMetaType<AnyMessage>("AnyMessage");
+    for (int id = WireProtocol::HELLO; id < WireProtocol::NUM_MESSAGE_IDS; ++id) {
+        Metrics::setMessageName(id, WireProtocol::messageType(WireProtocol::MessageId(id)).toStdString());
+    }
+
+    handlers.on<JoinGameRequestMessage, &Server::joinTable>();
+    handlers.on<ResumeSessionMessage, &Server::resumeSession>();
+    handlers.on<PlayerActionMessage, &Server::playerAction>();
+    handlers.on<RequestStateMessage, &Server::requestState>();
+    handlers.on<RevealCardsMessage, &Server::revealCards>();
+
+    for (int i = 0; i < qMax(1, numTables); ++i) {
+        Table *table = new Table();
+        table->id = i;
+        table->engine = new Engine(this);
+        table->engine->set_table_id(i);
+        // The seat to act is let through before the state telling it to act goes out
+        connect(table->engine, &Engine::gameStateUpdated, this, [this, table]() {
+            houseBotsHandStarted(table);
+            updateActionClock(table);
+            pushStateDelta(table);
+        });
+        table->clock.callback = [this, table]() { actionClockExpired(table); };
+        tables.append(table);
+    }
+
+    QVector<QAtomicInt*> spectatorCounts;
+    for (Table *table : tables) spectatorCounts.append(&table->spectators);
+
+    if (ioThreads <= 0) ioThreads = qMax(1, QThread::idealThreadCount());
+    for (int i = 0; i < ioThreads; ++i) {
+        IoShard *shard = new IoShard(i, spectatorCounts);
+        connect(shard, &IoShard::connectionOpened, this, [this, shard](ServerWorker *worker) { clientConnected(shard, worker); });
+        connect(shard, &IoShard::messageReceived, this, &Server::messageReceived);
+        connect(shard, &IoShard::connectionClosed, this, &Server::clientDisconnected);
+        connect(shard, &IoShard::snapshotNeeded, this, [this](ServerWorker *worker) {
+            auto it = sessions.constFind(worker);
+            if (it != sessions.cend() && it->tableId >= 0) sendState(tables[it->tableId], worker);
+        });
+        connect(shard, &IoShard::feedRequested, this, [this, shard](int tableId) {
+            Table *table = tables[tableId];
+            pushStateDelta(table);
+            shard->publishState(table->id, table->pushedState, table->stateVersion, {});
+        });
+        shards.append(shard);
+    }
+
+    connect(&clockTimer, &QTimer::timeout, this, [this]() { clocks.advance(quint64(clockTime.elapsed()) / CLOCK_TICK_MS); });
+
+    connect(&localServer, &LocalServer::connectionAccepted, this, [this](qintptr socketDescriptor) {
+        IoShard *shard = leastLoadedShard();
+        QMetaObject::invokeMethod(shard, [shard, socketDescriptor]() { shard->addLocalConnection(socketDescriptor); }, Qt::QueuedConnection);
+    });
+}
+
+Server::~Server() {
+    qDeleteAll(shards);
+    for (Table *table : tables) qDeleteAll(table->houseBots);
+    qDeleteAll(tables);
+}
 
+bool Server::startServer(quint16 port) {
+    Trace::setThreadName("table");
+    clockTime.start();
+    clockTimer.start(CLOCK_TICK_MS);
+    return listen(QHostAddress::Any, port);
 }
 
-void Server::sendJson(ServerWorker *destination, const QJsonObject &msg) {
+bool Server::startLocalServer(const QString &path) {
+    // Only this user's processes may connect, the memory is theirs to write to
+    QLocalServer::removeServer(path);
+    localServer.setSocketOptions(QLocalServer::UserAccessOption);
+    return localServer.listen(path);
+}
+
+QString Server::localErrorString() const {
+    return localServer.errorString();
+}
+
+IoShard *Server::leastLoadedShard() const {
+    IoShard *shard = shards.first();
+    for (IoShard *candidate : shards) {
+        if (candidate->get_connection_count() < shard->get_connection_count()) shard = candidate;
+    }
+    return shard;
+}
+
+void Server::incomingConnection(qintptr socketDescriptor) {
+
+    // The socket is created on the least loaded shard and never touched from this thread
+    IoShard *shard = leastLoadedShard();
+    QMetaObject::invokeMethod(shard, [shard, socketDescriptor]() { shard->addConnection(socketDescriptor); }, Qt::QueuedConnection);
+
+}
+
+void Server::clientConnected(IoShard *shard, ServerWorker *worker) {
+    Session session;
+    session.shard = shard;
+    sessions.insert(worker, session);
+    LOG_INFO(LOG_NET, "New client connected on I/O thread %d", shard->get_index());
+}
+
+void Server::sendMessage(ServerWorker *destination, const AnyMessage &message) {
     Q_ASSERT(destination);
-    destination->sendJson(msg);
+    const QByteArray frame = encodeFrame(message, destination->get_wire_version());
+    LOG_DEBUG(LOG_PROTOCOL, "Sending %s to %s (%d bytes)", qPrintable(WireProtocol::messageType(WireProtocol::messageId(message))), qPrintable(sessions.value(destination).username), int(frame.size()));
+    sendFrame(destination, frame);
 }
 
-void Server::broadcast(const QJsonObject &msg, ServerWorker *exclude) {
-    for (ServerWorker* worker : clients) {
+void Server::sendFrame(ServerWorker *destination, const QByteArray &frame, FrameKind kind) {
+    auto it = sessions.constFind(destination);
+    if (it != sessions.cend()) it->shard->sendFrame(destination, frame, kind);
+}
+
+void Server::broadcast(Table *table, const AnyMessage &message, ServerWorker *exclude) {
+    TRACE_SCOPE_ARG("server", "broadcast", "table", table->id);
+
+    AnyMessage msg = message;
+    const WireProtocol::MessageId id = WireProtocol::messageId(msg);
+    if (quint32 *seq = eventSeq(msg)) {
+        *seq = ++table->eventSeq;
+        table->events.enqueue(msg);
+        if (table->events.size() > TABLE_EVENT_HISTORY) table->events.dequeue();
+    }
+
+    // Encode at most once per wire version, every recipient shares the same frame,
+    // and each shard gets one batch per version instead of one call per socket
+    QByteArray frames[WIRE_PROTOCOL_VERSION + 1];
+    QHash<IoShard*, QVector<ServerWorker*>> batches[WIRE_PROTOCOL_VERSION + 1];
+    int recipients = 0;
+    const FrameKind kind = id == WireProtocol::STATE_DELTA ? FRAME_DELTA : FRAME_MESSAGE;
+
+    for (ServerWorker *worker : table->members) {
         if (worker == exclude) continue;
-        sendJson(worker, msg);
+        const int version = worker->get_wire_version();
+        if (frames[version].isNull()) frames[version] = encodeFrame(msg, version);
+        batches[version][sessions.value(worker).shard].append(worker);
+        recipients++;
+    }
+
+    for (int version = 0; version <= WIRE_PROTOCOL_VERSION; ++version) {
+        for (auto it = batches[version].cbegin(); it != batches[version].cend(); ++it) {
+            it.key()->sendFrame(it.value(), frames[version], kind);
+        }
     }
+
+    // Broadcasts are public, private messages such as hole cards go through sendMessage
+    if (table->spectators.loadRelaxed() > 0) publishToSpectators(table, frames, msg, kind == FRAME_DELTA);
+
+    LOG_DEBUG(LOG_PROTOCOL, "Broadcast %s to %d clients at table %d", qPrintable(WireProtocol::messageType(id)), recipients, table->id);
 }
 
+void Server::publishToSpectators(Table *table, QByteArray (&frames)[WIRE_PROTOCOL_VERSION + 1], const AnyMessage &msg, bool stateChanged) {
 
-void Server::jsonReceived(ServerWorker *sender, const QJsonObject &doc) {
+    // One encode per wire version however many watch, each shard fans out to its own spectators
+    QVector<QByteArray> encoded;
+    for (int version = 0; version <= WIRE_PROTOCOL_VERSION; ++version) {
+        if (frames[version].isNull()) frames[version] = encodeFrame(msg, version);
+        encoded.append(frames[version]);
+    }
+    for (IoShard *shard : shards) {
+        if (stateChanged) {
+            shard->publishState(table->id, table->pushedState, table->stateVersion, encoded);
+        } else {
+            shard->publishEvent(table->id, encoded);
+        }
+    }
+}
 
-    Q_ASSERT(sender);
+void Server::messageReceived(ServerWorker *sender, const AnyMessage &message, quint64 decodedAt) {
 
-    emit logMessage(QLatin1String("JSON received ") + QString::fromUtf8(QJsonDocument(doc).toJson()));
+    Q_ASSERT(sender);
+    const uint64_t start = Metrics::now();
+    Metrics::record(STAGE_DISPATCH, start - decodedAt);
+    if (!sessions.contains(sender)) return;
+
+    const WireProtocol::MessageId messageId = WireProtocol::messageId(message);
+    LOG_DEBUG(LOG_PROTOCOL, "Received %s", qPrintable(WireProtocol::messageType(messageId)));
+    {
+        TRACE_SCOPE_ARG("server", "handle_message", "type", messageId);
+        handlers.dispatch(this, sender, message);
+    }
+    Metrics::recordMessage(messageId, Metrics::now() - start);
+}
 
-    const QString type = doc.value(QLatin1String("type")).toString();
-    const QJsonObject payload = doc.value(QLatin1String("payload")).toObject();
+// Everything but joining, resuming and REQUEST_STATE acts at the table the connection is seated at
+Table *Server::seatedTable(ServerWorker *sender) {
+    const Session &session = sessions[sender];
+    if (session.tableId < 0) {
+        sendError(sender, QStringLiteral("Join a table first"));
+        return nullptr;
+    }
+    return tables[session.tableId];
+}
 
-    if (type == QLatin1String("JOIN_GAME_REQUEST")) {
+void Server::playerAction(ServerWorker *sender, const PlayerActionMessage &request) {
 
-        const QString username = payload.value(QLatin1String("username")).toString();
+    Table *table = seatedTable(sender);
+    if (!table) return;
+    const int seat = sessions[sender].seat;
 
-        // TODO: player joining game
+    Engine *engine = table->engine;
+    // One action per turn, including the one made for a seat that ran out of time
+    if (engine->get_state() != PLAYERACTION || engine->has_pending_action()) return;
 
-        QJsonObject message;
-        message["type"] = "JOIN_GAME_ACCEPT";
+    // The seat comes from the session, whatever player_id the client put in the payload
+    if (seat < 0 || engine->get_current_playerID() != seat) return;
 
-        QJsonObject payload;
-        payload["player_id"] = 1; // player id allocation TODO
-        payload["username"] = username;
+    if (request.action == WireProtocol::NO_ACTION) return;
+    Action action = Action(action_types[request.action], request.amount);
 
-        message["payload"] = payload;
-        broadcast(message, nullptr);
+    // Reject here rather than letting a bad action sit in the engine queue
+    const LegalActions legal = engine->get_legal_actions();
+    if (!legal.allows(action)) {
+        if (action.type == RAISE && legal.can(RAISE)) {
+            sendError(sender, QStringLiteral("Raise must be between $%1 and $%2").arg(legal.min_raise).arg(legal.max_raise));
+        } else {
+            sendError(sender, QStringLiteral("Cannot %1 now").arg(WireProtocol::actionName(request.action).toLower()));
+        }
         return;
+    }
 
-    } else if (type == QLatin1String("PLAYER_ACTION")) {
+    engine->makeAction(action);
+    stopActionClock(table);
 
-        if (gameEngine->get_state() != PLAYERACTION) return;
+    PlayerActionMessage echo;
+    echo.player_id = seat;
+    echo.action = request.action;
+    echo.amount = request.amount;
+    broadcast(table, echo, nullptr);
+    houseBotsActionMade(table, seat, action);
+}
 
-        int player_id = payload.value(QLatin1String("player_id")).toInt();
-        if (gameEngine->get_current_playerID() != player_id) return;
+void Server::requestState(ServerWorker *sender, const RequestStateMessage &) {
+    // Nothing to send without a table, and no ERROR either: a client asks for the state after
+    // an ERROR, and the two would keep answering each other for as long as it stays connected
+    const Session &session = sessions[sender];
+    if (session.tableId < 0) return;
+    sendState(tables[session.tableId], sender);
+}
 
-        unordered_map<string, ActionType> string_to_action = {
-            {"CHECK", CHECK},
-            {"CALL", CALL},
-            {"FOLD", FOLD},
-            {"RAISE", RAISE}
-        };
+void Server::revealCards(ServerWorker *sender, const RevealCardsMessage &request) {
 
-        const string action_str = payload.value(QLatin1String("action")).toString().toStdString();
-        if (!string_to_action.count(action_str)) return;
+    Table *table = seatedTable(sender);
+    const int seat = sessions[sender].seat;
+    if (!table || seat < 0) return;
 
-        int amount = payload.value(QLatin1String("amount")).toInt();
+    // Received from a specific player, and is broadcast out to the rest of the table
+    RevealCardsMessage reveal;
+    reveal.player_id = seat;
+    reveal.cards = request.cards;
+    broadcast(table, reveal, sender);
+}
 
-        Action action = Action(string_to_action[action_str], amount);
-        gameEngine->makeAction(action);
+// Seats username at the requested table, or the first one with a free seat. nullptr if there is none
+Table *Server::takeSeat(const QString &username, int requested, int *seat) {
+    for (Table *candidate : tables) {
+        if (requested >= 0 && candidate->id != requested) continue;
+        *seat = candidate->engine->addPlayer(username);
+        if (*seat != -1) return candidate;
+    }
+    return nullptr;
+}
+
+void Server::joinTable(ServerWorker *sender, const JoinGameRequestMessage &request) {
+
+    Session &session = sessions[sender];
+    if (session.tableId >= 0) {
+        sendError(sender, QStringLiteral("Already seated at table %1").arg(session.tableId));
+        return;
+    }
 
-        broadcast(doc, nullptr);
+    const QString username = request.username;
+    if (username.isEmpty()) {
+        sendError(sender, QStringLiteral("A username is required"));
+        return;
+    }
 
-    } else if (type == QLatin1String("REQUEST_STATE")) {
+    const int requested = request.table_id;
+    int seat = -1;
+    Table *table = takeSeat(username, requested, &seat);
+    if (!table) {
+        sendError(sender, requested >= 0 ? QStringLiteral("Table %1 is full or does not exist").arg(requested) : QStringLiteral("Every table is full"));
+        return;
+    }
 
-        QJsonObject gameState;
+    session.username = username;
+    session.tableId = table->id;
+    session.seat = seat;
+    session.resumeToken = newResumeToken();
+    table->members.append(sender);
+
+    SeatHold hold;
+    hold.tableId = table->id;
+    hold.seat = seat;
+    hold.username = username;
+    hold.connection = sender;
+    hold.expiry = QDeadlineTimer(QDeadlineTimer::Forever);
+    holds.insert(session.resumeToken, hold);
+    if (table->seats.size() <= seat) table->seats.resize(seat + 1);
+    table->seats[seat] = sender;
+    while (table->timeBanks.size() <= seat) table->timeBanks.append(TIME_BANK_MS);
+    LOG_INFO(LOG_SERVER, "%s seated at table %d as player %d", qPrintable(username), table->id, seat);
+
+    JoinGameAcceptMessage accept;
+    accept.player_id = seat;
+    accept.username = username;
+    accept.table_id = table->id;
+    accept.resume_token = session.resumeToken;
+    accept.seq = table->eventSeq;
+    sendMessage(sender, accept);
+
+    PlayerJoinedMessage joined;
+    joined.player_id = seat;
+    joined.username = username;
+    broadcast(table, joined, sender);
+
+    pushStateDelta(table);
+}
 
-        QJsonArray players;
-        for (const Player& player : gameEngine->get_players()) {
+void Server::resumeSession(ServerWorker *sender, const ResumeSessionMessage &request) {
 
-            QString username = QString::fromStdString(player.get_username());
-            int stack = player.get_stack();
-            QString role;
-            if (player == gameEngine->get_dealer()) {
-                role = QString::fromStdString("D");
-            } else if (player == gameEngine->get_sb()) {
-                role = QString::fromStdString("SB");
-            } else if (player == gameEngine->get_bb()) {
-                role = QString::fromStdString("BB");
-            } else {
-                role = QString::fromStdString("None");
-            }
+    const QString token = request.resume_token;
+    auto holdIt = holds.find(token);
+    if (sessions.value(sender).tableId >= 0 || holdIt == holds.end()) {
+        ResumeRejectMessage reject;
+        reject.message = QStringLiteral("Session cannot be resumed");
+        sendMessage(sender, reject);
+        return;
+    }
 
-            QJsonObject playerObj;
-            playerObj[QLatin1String("username")] = username;
-            playerObj[QLatin1String("stack")] = stack;
-            playerObj[QLatin1String("role")] = role;
+    SeatHold &hold = holdIt.value();
+    Table *table = tables[hold.tableId];
 
-            players.append(playerObj);
-        }
+    // The client may come back before the server has noticed the old socket is dead
+    if (hold.connection) {
+        ServerWorker *stale = hold.connection;
+        const Session staleSession = sessions.take(stale);
+        table->members.removeAll(stale);
+        QMetaObject::invokeMethod(staleSession.shard, [shard = staleSession.shard, stale]() { shard->closeConnection(stale); }, Qt::QueuedConnection);
+    }
 
-        gameState[QLatin1String("players")] = players;
-        gameState[QLatin1String("game_no")] = gameEngine->get_game_no();
-        unordered_map<Round, string> round_to_string = {
-            {PREFLOP, "PREFLOP"},
-            {FLOP, "FLOP"},
-            {TURN, "TURN"},
-            {RIVER, "RIVER"}
-        };
-        gameState[QLatin1String("pot")] = gameEngine->get_pot();
-
-        QJsonArray board;
-        for (Card card : gameEngine->get_board()) {
-            board.append(QString::fromStdString(card.to_string()));
+    Session &session = sessions[sender];
+    session.username = hold.username;
+    session.tableId = hold.tableId;
+    session.seat = hold.seat;
+    session.resumeToken = token;
+    hold.connection = sender;
+    hold.expiry = QDeadlineTimer(QDeadlineTimer::Forever);
+    table->members.append(sender);
+    table->seats[hold.seat] = sender;
+    if (table->clock.armed() && table->clockSeat == hold.seat) grantAction(table, hold.seat, true);
+
+    ResumeAcceptMessage accept;
+    accept.player_id = hold.seat;
+    accept.username = hold.username;
+    accept.table_id = hold.tableId;
+    accept.resume_token = token;
+    accept.seq = table->eventSeq;
+    sendMessage(sender, accept);
+
+    // Replay what was missed if the history still reaches back that far, the snapshot below
+    // brings the state up to date either way
+    const quint32 lastSeen = request.seq;
+    int replayed = 0;
+    if (!table->events.isEmpty() && *eventSeq(table->events.head()) <= lastSeen + 1) {
+        for (AnyMessage &event : table->events) {
+            if (*eventSeq(event) <= lastSeen) continue;
+            sendMessage(sender, event);
+            replayed++;
         }
-        gameState[QLatin1String("board")] = board;
+    }
+    sendState(table, sender);
+
+    LOG_INFO(LOG_SERVER, "%s resumed at table %d, %d events replayed", qPrintable(hold.username), hold.tableId, replayed);
+}
+
+void Server::expireHold(const QString &token) {
+
+    auto it = holds.find(token);
+    if (it == holds.end() || it->connection || !it->expiry.hasExpired()) return;
+
+    const SeatHold hold = it.value();
+    holds.erase(it);
+    Table *table = tables[hold.tableId];
+
+    // Free the seat for someone else
+    table->engine->removePlayer(hold.seat);
+
+    PlayerLeftMessage left;
+    left.username = hold.username;
+    left.player_id = hold.seat;
+    broadcast(table, left, nullptr);
+
+    // The seat folds now if it is its turn, any other seat's clock keeps running
+    if (table->clockSeat == hold.seat) updateActionClock(table);
+    else table->clockVersion = table->engine->get_state_version();
+    pushStateDelta(table);
+    // Whoever takes the seat next starts with a full time bank
+    if (hold.seat < table->timeBanks.size()) table->timeBanks[hold.seat] = TIME_BANK_MS;
+
+    LOG_INFO(LOG_SERVER, "%s did not resume, left table %d", qPrintable(hold.username), hold.tableId);
+}
+
+void Server::sendError(ServerWorker *destination, const QString &reason) {
+    ErrorMessage error;
+    error.message = reason;
+    sendMessage(destination, error);
+}
+
+void Server::sendState(Table *table, ServerWorker *destination) {
+
+    // Bring everyone up to date first so the snapshot matches the version clients build on
+    pushStateDelta(table);
+
+    // Requests between transitions all share the same encoded snapshot
+    const int wireVersion = destination->get_wire_version();
+    QByteArray &frame = table->stateFrames[wireVersion];
+    if (frame.isNull()) {
+        frame = encodeFrame(table->pushedState.toMessage(table->stateVersion), wireVersion);
+    }
+
+    sendFrame(destination, frame, FRAME_SNAPSHOT);
+}
 
-        gameState[QLatin1String("current_player")] = gameEngine->get_current_playerID();
+void Server::pushStateDelta(Table *table) {
+    TRACE_SCOPE_ARG("server", "push_state", "table", table->id);
 
-        sendJson(sender, gameState);
+    // Nothing to do if the game has not changed since the last capture
+    const qint64 gameVersion = qint64(table->engine->get_state_version());
+    if (gameVersion == table->pushedGameVersion) return;
+    table->pushedGameVersion = gameVersion;
+
+    PublicState current = PublicState::capture(*table->engine);
+    StateDeltaMessage delta;
+    if (!current.delta(table->pushedState, table->stateVersion + 1, delta)) return;
+
+    table->stateVersion++;
+    table->pushedState = current;
+    for (QByteArray &frame : table->stateFrames) frame.clear();
+
+    broadcast(table, delta, nullptr);
+}
+
+void Server::updateActionClock(Table *table) {
+
+    Engine *engine = table->engine;
+    if (engine->get_state() != PLAYERACTION) {
+        stopActionClock(table);
         return;
+    }
 
-    } else if (type == QLatin1String("REVEAL_CARDS")) {
-        // Received from a specific player (player_id), and is broadcast out to every client
-        broadcast(doc, sender);
+    // Still the same turn, its clock is already running (or the seat has acted and the engine has yet to apply it)
+    const int seat = engine->get_current_playerID();
+    const quint64 version = engine->get_state_version();
+    if (seat == table->clockSeat && version == table->clockVersion) return;
+
+    // A seat whose player has left folds as soon as its turn comes round
+    if (!engine->is_seated(seat)) {
+        stopActionClock(table);
+        table->clockSeat = seat;
+        table->clockVersion = version;
+        if (!engine->has_pending_action()) actFor(table, seat, FOLD);
+        return;
+    }
 
+    // House bots answer from their own threads, against their budget rather than a clock
+    if (seat < table->houseBots.size() && table->houseBots[seat]) {
+        stopActionClock(table);
+        table->clockSeat = seat;
+        table->clockVersion = version;
+        houseBotTurn(table, seat);
+        return;
     }
 
+    grantAction(table, table->clockSeat, false);
+    grantAction(table, seat, true);
+    table->clockSeat = seat;
+    table->clockVersion = version;
+    table->onTimeBank = false;
+    clocks.schedule(&table->clock, ACTION_TIME_MS / CLOCK_TICK_MS);
+    broadcastClock(table, ACTION_TIME_MS);
 }
 
-void Server::clientDisconnected(ServerWorker *sender) {
-    clients.removeAll(sender);
-    const QString username = sender->get_username();
-    if (!username.isEmpty()) {
-        QJsonObject disconnectedMessage;
-        disconnectedMessage[QLatin1String("type")] = QLatin1String("PLAYER_LEFT");
+void Server::stopActionClock(Table *table) {
+    grantAction(table, table->clockSeat, false);
+    if (!table->clock.armed()) return;
+    table->clock.cancel();
+
+    // Only the part of the time bank actually used is spent
+    if (table->onTimeBank && table->clockSeat >= 0 && table->clockSeat < table->timeBanks.size()) {
+        int &bank = table->timeBanks[table->clockSeat];
+        bank = qMax(0, bank - int((clocks.now() - table->timeBankStart) * CLOCK_TICK_MS));
+    }
+    table->onTimeBank = false;
+}
 
-        QJsonObject payload;
-        payload[QLatin1String("username")] = username;
+void Server::actionClockExpired(Table *table) {
 
-        disconnectedMessage[QLatin1String("payload")] = payload;
+    Engine *engine = table->engine;
+    const int seat = table->clockSeat;
+    if (engine->get_state() != PLAYERACTION || engine->has_pending_action() || engine->get_current_playerID() != seat) return;
 
-        broadcast(disconnectedMessage, nullptr);
-        emit logMessage(username + QLatin1String(" disconnected"));
+    // Out of regular time, keep going on the seat's time bank if it has one
+    const int bank = seat < table->timeBanks.size() ? table->timeBanks[seat] : 0;
+    if (!table->onTimeBank && bank >= CLOCK_TICK_MS) {
+        table->onTimeBank = true;
+        table->timeBankStart = clocks.now();
+        clocks.schedule(&table->clock, quint64(bank) / CLOCK_TICK_MS);
+        broadcastClock(table, bank);
+        return;
     }
-    sender->deleteLater();
+    if (seat < table->timeBanks.size()) table->timeBanks[seat] = 0;
+    table->onTimeBank = false;
+
+    // Check when that costs nothing, fold otherwise
+    const ActionType type = engine->get_legal_actions().can(CHECK) ? CHECK : FOLD;
+    actFor(table, seat, type);
+
+    LOG_INFO(LOG_SERVER, "Player %d at table %d ran out of time and %s", seat, table->id, type == CHECK ? "checked" : "folded");
+}
+
+void Server::actFor(Table *table, int seat, ActionType type) {
+    grantAction(table, seat, false);
+    table->engine->makeAction(Action(type, 0));
+
+    PlayerActionMessage action;
+    action.player_id = seat;
+    action.action = wireAction(type);
+    action.timed_out = true;
+    broadcast(table, action, nullptr);
+    houseBotsActionMade(table, seat, Action(type, 0));
+}
+
+void Server::broadcastClock(Table *table, int remainingMs) {
+    ActionClockMessage clock;
+    clock.player_id = table->clockSeat;
+    clock.remaining_ms = remainingMs;
+    clock.time_bank = table->onTimeBank;
+    broadcast(table, clock, nullptr);
+}
+
+void Server::grantAction(Table *table, int seat, bool granted) {
+    // Lets the shard turn away PLAYER_ACTION from everyone else without waking this thread
+    ServerWorker *worker = seat >= 0 && seat < table->seats.size() ? table->seats[seat] : nullptr;
+    if (worker) worker->set_accepting(WireProtocol::PLAYER_ACTION, granted);
+}
+
+void Server::clientDisconnected(ServerWorker *sender) {
+    if (!sessions.contains(sender)) return;
+    const Session session = sessions.take(sender);
+    IoShard *shard = session.shard;
+
+    if (session.tableId >= 0) {
+        Table *table = tables[session.tableId];
+        table->members.removeAll(sender);
+        if (session.seat >= 0) table->seats[session.seat] = nullptr;
+
+        // Hold the seat for a while, PLAYER_LEFT only goes out if the client does not resume
+        auto holdIt = holds.find(session.resumeToken);
+        if (holdIt != holds.end() && holdIt->connection == sender) {
+            holdIt->connection = nullptr;
+            holdIt->expiry = QDeadlineTimer(RESUME_GRACE_MS);
+            const QString token = session.resumeToken;
+            QTimer::singleShot(RESUME_GRACE_MS, Qt::PreciseTimer, this, [this, token]() { expireHold(token); });
+        }
+        LOG_INFO(LOG_SERVER, "%s disconnected from table %d", qPrintable(session.username), table->id);
+    }
+
+    // Anything already queued for this socket is written before the shard deletes it
+    QMetaObject::invokeMethod(shard, [shard, sender]() { shard->closeConnection(sender); }, Qt::QueuedConnection);
 }
 
 void Server::userError(ServerWorker* sender) {
-    Q_UNUSED(sender);
-    emit logMessage(QLatin1String("Error from ") + sender->get_username());
+    LOG_WARN(LOG_NET, "Error from %s", qPrintable(sessions.value(sender).username));
 }
 
 void Server::stopServer() {
-    for (ServerWorker* worker : clients) {
-        worker->disconnectFromClient();
+    for (IoShard *shard : shards) {
+        QMetaObject::invokeMethod(shard, &IoShard::disconnectAll, Qt::QueuedConnection);
     }
     close();
+    localServer.close();
+}
+
+bool Server::seatHouseBot(const QString &library, const QString &config, QString *error) {
+
+    const BotLibrary *plugin = BotLibrary::load(library, error);
+    if (!plugin) return false;
+    HouseBot *bot = plugin->create(config);
+    if (!bot) {
+        *error = QStringLiteral("%1 did not create a bot").arg(library);
+        return false;
+    }
+
+    const QString username = QStringLiteral("%1_%2").arg(plugin->get_name()).arg(houseBotsSeated);
+    int seat = -1;
+    Table *table = takeSeat(username, -1, &seat);
+    if (!table) {
+        delete bot;
+        *error = QStringLiteral("Every table is full");
+        return false;
+    }
+    houseBotsSeated++;
+
+    // Seats are numbered the same for connections and bots, a bot's connection is always nullptr
+    if (table->houseBots.size() <= seat) table->houseBots.resize(seat + 1);
+    table->houseBots[seat] = new SeatedBot(bot, username, seat, this);
+    if (table->seats.size() <= seat) table->seats.resize(seat + 1);
+    while (table->timeBanks.size() <= seat) table->timeBanks.append(TIME_BANK_MS);
+    LOG_INFO(LOG_SERVER, "House bot %s seated at table %d as player %d", qPrintable(username), table->id, seat);
+
+    PlayerJoinedMessage joined;
+    joined.player_id = seat;
+    joined.username = username;
+    broadcast(table, joined, nullptr);
+
+    pushStateDelta(table);
+    return true;
+}
+
+void Server::setHouseBotBudget(int ms) {
+    houseBotBudgetNs = uint64_t(qMax(1, ms)) * 1000000;
+}
+
+BotView Server::houseBotView(Table *table, int seat, const LegalActions &legal) {
+    return BotView(table->engine->get_table(), seat, table->engine->get_game_no(), legal);
+}
+
+void Server::houseBotsHandStarted(Table *table) {
+    if (table->houseBots.isEmpty()) return;
+    Engine *engine = table->engine;
+    if (engine->get_state() == IDLE || engine->get_state() == INITGAME || engine->get_game_no() == table->houseBotGame) return;
+    table->houseBotGame = engine->get_game_no();
+    for (SeatedBot *bot : table->houseBots) {
+        if (bot) bot->hand_started(houseBotView(table, bot->get_seat()));
+    }
+}
+
+void Server::houseBotsActionMade(Table *table, int seat, const Action &action) {
+    for (SeatedBot *bot : table->houseBots) {
+        if (bot) bot->action_made(houseBotView(table, bot->get_seat()), seat, action);
+    }
+}
+
+void Server::houseBotTurn(Table *table, int seat) {
+
+    Engine *engine = table->engine;
+    if (engine->has_pending_action()) return;
+
+    const quint64 version = table->clockVersion;
+    table->houseBots[seat]->decide(houseBotView(table, seat, engine->get_legal_actions()), houseBotBudgetNs,
+                                   [this, table, seat, version](const Action &action) { houseBotAnswered(table, seat, version, action); });
+}
+
+void Server::houseBotAnswered(Table *table, int seat, quint64 version, const Action &action) {
+
+    // Only while it is still the turn the bot was asked about
+    Engine *engine = table->engine;
+    if (table->clockSeat != seat || table->clockVersion != version) return;
+    if (engine->get_state() != PLAYERACTION || engine->has_pending_action() || engine->get_current_playerID() != seat) return;
+    engine->makeAction(action);
+
+    PlayerActionMessage echo;
+    echo.player_id = seat;
+    echo.action = wireAction(action.type);
+    echo.amount = action.amount;
+    broadcast(table, echo, nullptr);
+    houseBotsActionMade(table, seat, action);
 }
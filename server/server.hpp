@@ -2,14 +2,21 @@
 
 #include <QObject>
 #include <QTcpServer>
+#include <QLocalServer>
 #include <QTcpSocket>
-#include <QJsonObject>
-#include <QJsonDocument>
-#include <QJsonArray>
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QDebug>
 
 #include "serverworker.hpp"
+#include "ioshard.hpp"
 #include "engine.hpp"
+#include "publicstate.hpp"
+#include "session.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "wireprotocol.hpp"
+#include "messages.hpp"
 
 using namespace std;
 
@@ -19,26 +26,93 @@ using namespace std;
 
 #define SERVER_IP "127.0.0.1"
 
+// Hands accepted local sockets on as descriptors, like QTcpServer::incomingConnection,
+// so that they can be set up on an I/O shard
+class LocalServer : public QLocalServer
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(LocalServer)
+public:
+    using QLocalServer::QLocalServer;
+signals:
+    void connectionAccepted(qintptr socketDescriptor);
+protected:
+    void incomingConnection(quintptr socketDescriptor) override { emit connectionAccepted(qintptr(socketDescriptor)); }
+};
+
+// Every table runs on the thread the server lives on: sessions, seat holds, action clocks and
+// the engines' game loops are all handled there. Only socket I/O and message decoding are
+// spread over the IoShard threads, so one busy table can hold up the others
 class Server : public QTcpServer
 {
     Q_OBJECT
     Q_DISABLE_COPY(Server)
 public:
-    explicit Server(QObject* parent = nullptr);
+    // ioThreads is the number of socket threads, 0 picks one per core
+    explicit Server(QObject* parent = nullptr, int ioThreads = 0, int numTables = 1);
+    ~Server();
 protected:
     void incomingConnection(qintptr socketDescriptor) override;
-signals:
-    void logMessage(const QString& msg);
 public slots:
+    bool startServer(quint16 port);
+    // Also accept bots on this host at path, they then talk to the server through shared memory
+    bool startLocalServer(const QString &path);
+    QString localErrorString() const;
+    // Loads a bot library and seats one of its bots at the first table with a free seat.
+    // config is passed to the bot as it is. Returns false and sets error if that fails
+    bool seatHouseBot(const QString &library, const QString &config, QString *error);
+    // Time each house bot decision may take before the table plays a check or fold for it
+    void setHouseBotBudget(int ms);
     void stopServer();
 private slots:
-    void broadcast(const QJsonObject& msg, ServerWorker *exclude);
-    void jsonReceived(ServerWorker *sender, const QJsonObject &doc);
+    void messageReceived(ServerWorker *sender, const AnyMessage &message, quint64 decodedAt);
     void clientDisconnected(ServerWorker *client);
     void userError(ServerWorker *client);
 private:
-    void receiveJson(ServerWorker *sender, const QJsonObject &doc);
-    void sendJson(ServerWorker *destination, const QJsonObject &msg);
-    QVector<ServerWorker*> clients;
-    Engine* gameEngine;
+    IoShard *leastLoadedShard() const;
+    void clientConnected(IoShard *shard, ServerWorker *worker);
+    // Handlers for what clients send, see handlers
+    void joinTable(ServerWorker *sender, const JoinGameRequestMessage &request);
+    void resumeSession(ServerWorker *sender, const ResumeSessionMessage &request);
+    void playerAction(ServerWorker *sender, const PlayerActionMessage &request);
+    void requestState(ServerWorker *sender, const RequestStateMessage &request);
+    void revealCards(ServerWorker *sender, const RevealCardsMessage &request);
+    Table *seatedTable(ServerWorker *sender);
+    Table *takeSeat(const QString &username, int requested, int *seat);
+    BotView houseBotView(Table *table, int seat, const LegalActions &legal = LegalActions());
+    void houseBotsHandStarted(Table *table);
+    void houseBotsActionMade(Table *table, int seat, const Action &action);
+    void houseBotTurn(Table *table, int seat);
+    void houseBotAnswered(Table *table, int seat, quint64 version, const Action &action);
+    void expireHold(const QString &token);
+    void broadcast(Table *table, const AnyMessage &message, ServerWorker *exclude);
+    void sendState(Table *table, ServerWorker *destination);
+    void pushStateDelta(Table *table);
+    void publishToSpectators(Table *table, QByteArray (&frames)[WIRE_PROTOCOL_VERSION + 1], const AnyMessage &msg, bool stateChanged);
+    void sendError(ServerWorker *destination, const QString &reason);
+    void updateActionClock(Table *table);
+    void stopActionClock(Table *table);
+    void actionClockExpired(Table *table);
+    // Makes an action for the seat to act that it did not make itself, announced as timed out
+    void actFor(Table *table, int seat, ActionType type);
+    void broadcastClock(Table *table, int remainingMs);
+    void grantAction(Table *table, int seat, bool granted);
+    void sendMessage(ServerWorker *destination, const AnyMessage &message);
+    void sendFrame(ServerWorker *destination, const QByteArray &frame, FrameKind kind = FRAME_MESSAGE);
+
+    // Sockets live on the I/O shards, this thread keeps a session for each one.
+    // A worker is never dereferenced here after its session has been removed.
+    QVector<IoShard*> shards;
+    LocalServer localServer;
+    QHash<ServerWorker*, Session> sessions;
+    QVector<Table*> tables;
+    QHash<QString, SeatHold> holds; // by resume token
+    MessageDispatch<Server, ServerWorker*> handlers;
+    uint64_t houseBotBudgetNs = uint64_t(HOUSE_BOT_BUDGET_MS) * 1000000;
+    int houseBotsSeated = 0; // numbers their names
+
+    // Every table's action clock runs on this one wheel, advanced by clockTimer
+    TimerWheel clocks;
+    QElapsedTimer clockTime;
+    QTimer clockTimer;
 };
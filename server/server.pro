@@ -16,20 +16,47 @@ SOURCES += \
     engine.cpp \
     evaluate.cpp \
     game.cpp \
+    housebots.cpp \
+    ioshard.cpp \
+    logger.cpp \
+    metrics.cpp \
     player.cpp \
+    publicstate.cpp \
+    pots.cpp \
     server.cpp \
     serverwindow.cpp \
     serverworker.cpp \
+    tablestate.cpp \
+    timerwheel.cpp \
+    trace.cpp \
+    zobrist.cpp \
 
 HEADERS += \
+    botapi.hpp \
     cards.hpp \
     engine.hpp \
     evaluate.hpp \
     game.hpp \
+    housebots.hpp \
+    ioshard.hpp \
+    logger.hpp \
+    metrics.hpp \
     player.hpp \
+    publicstate.hpp \
+    pots.hpp \
     server.hpp \
     serverwindow.hpp \
     serverworker.hpp \
+    session.hpp \
+    tablestate.hpp \
+    timerwheel.hpp \
+    trace.hpp \
+    zobrist.hpp \
+
+INCLUDEPATH += ../shared
+
+SOURCES += ../shared/wireprotocol.cpp ../shared/messages.cpp ../shared/shmchannel.cpp
+HEADERS += ../shared/wireprotocol.hpp ../shared/messages.hpp ../shared/messageschema.hpp ../shared/shmchannel.hpp
 
 FORMS += \
     serverwindow.ui
@@ -4,35 +4,54 @@
 ServerWindow::ServerWindow(QWidget *parent)
     : QWidget(parent)
     , ui(new Ui::ServerWindow)
-    , server(new Server(this))
+    , server(new Server())
 {
     ui->setupUi(this);
+    ui->logEditor->setMaximumBlockCount(5000); // keep the log widget from growing without bound
+
+    tableThread.setObjectName(QStringLiteral("table"));
+    server->moveToThread(&tableThread);
+    connect(&tableThread, &QThread::finished, server, &QObject::deleteLater);
+    tableThread.start();
+
     connect(ui->startStopButton, &QPushButton::clicked, this, &ServerWindow::toggleStartServer);
-    connect(server, &Server::logMessage, this, &ServerWindow::logMessage);
+
+    // The logger hands over batches of lines on its own thread
+    Logger::setListener([this](const string &lines) {
+        const QString text = QString::fromStdString(lines).trimmed();
+        QMetaObject::invokeMethod(this, [this, text]() { logMessage(text); }, Qt::QueuedConnection);
+    });
 }
 
 ServerWindow::~ServerWindow()
 {
+    Logger::setListener(nullptr);
+    tableThread.quit();
+    tableThread.wait();
     delete ui;
 }
 
 void ServerWindow::toggleStartServer()
 {
-    if (server->isListening()) {
-        server->stopServer();
+    if (serverRunning) {
+        QMetaObject::invokeMethod(server, &Server::stopServer, Qt::BlockingQueuedConnection);
+        serverRunning = false;
         ui->startStopButton->setText(tr("Start Server"));
-        logMessage(QStringLiteral("Server Stopped"));
+        LOG_INFO(LOG_SERVER, "Server stopped");
     } else {
-        if (!server->listen(QHostAddress::Any, SERVER_PORT)) {
+        bool started = false;
+        QMetaObject::invokeMethod(server, [this]() { return server->startServer(SERVER_PORT); }, Qt::BlockingQueuedConnection, &started);
+        if (!started) {
             QMessageBox::critical(this, tr("Error"), tr("Unable to start the server"));
             return;
         }
-        logMessage(QStringLiteral("Server Started"));
+        serverRunning = true;
+        LOG_INFO(LOG_SERVER, "Server started on port %d", SERVER_PORT);
         ui->startStopButton->setText(tr("Stop Server"));
     }
 }
 
 void ServerWindow::logMessage(const QString &msg)
 {
-    ui->logEditor->appendPlainText(msg + QLatin1Char('\n'));
+    ui->logEditor->appendPlainText(msg);
 }
@@ -2,6 +2,7 @@
 
 #include <QWidget>
 #include <QMessageBox>
+#include <QThread>
 #include "server.hpp"
 
 namespace Ui {
@@ -18,7 +19,10 @@ public:
 
 private:
     Ui::ServerWindow *ui;
+    // The server and engine run on their own thread so the widgets never hold up the game
+    QThread tableThread;
     Server* server;
+    bool serverRunning = false;
 private slots:
     void toggleStartServer();
     void logMessage(const QString &msg);
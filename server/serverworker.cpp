@@ -1,10 +1,27 @@
 #include "serverworker.hpp"
+#include "wireprotocol.hpp"
+#include "logger.hpp"
 
 #include <QOverload>
+#include <QTimer>
+#include <QtEndian>
 
-ServerWorker::ServerWorker(QObject *parent) : QObject(parent), serverSocket(new QTcpSocket(this)) {
+// What a connection may send before the table grants it more
+static const quint32 default_accepted = (1u << WireProtocol::HELLO) | (1u << WireProtocol::JOIN_GAME_REQUEST) | (1u << WireProtocol::REQUEST_STATE)
+                                      | (1u << WireProtocol::REVEAL_CARDS) | (1u << WireProtocol::RESUME_SESSION)
+                                      | (1u << WireProtocol::WATCH_TABLE) | (1u << WireProtocol::UNWATCH_TABLE);
+
+ServerWorker::ServerWorker(QObject *parent)
+    : QObject(parent)
+    , serverSocket(new QTcpSocket(this))
+    , acceptedMessages(default_accepted)
+    , tokensAt(Metrics::now()) {
+
+    // Stop pulling from the kernel while reads are paused, so the client's own sends block
+    serverSocket->setReadBufferSize(SOCKET_READ_BUFFER);
 
     connect(serverSocket, &QTcpSocket::readyRead, this, &ServerWorker::receiveJson);
+    connect(serverSocket, &QTcpSocket::bytesWritten, this, &ServerWorker::flushOutbound);
 
     connect(serverSocket, &QTcpSocket::disconnected, this, &ServerWorker::disconnectedFromClient);
     connect(serverSocket, &QAbstractSocket::errorOccurred, this, &ServerWorker::error);
@@ -14,7 +31,8 @@ bool ServerWorker::setSocketDescriptor(qintptr socketDescriptor) {
     return serverSocket->setSocketDescriptor(socketDescriptor);
 }
 void ServerWorker::disconnectFromClient() {
-    serverSocket->disconnectFromHost();
+    if (channel) channel->close();
+    else serverSocket->disconnectFromHost();
 }
 
 QString ServerWorker::get_username() const {
@@ -25,37 +43,284 @@ void ServerWorker::set_username(const QString &new_username) {
     username = new_username;
 }
 
+int ServerWorker::get_wire_version() const {
+    return wireVersion.loadRelaxed();
+}
+
+void ServerWorker::set_accepting(WireProtocol::MessageId id, bool accepting) {
+    if (accepting) acceptedMessages.fetchAndOrRelaxed(1u << id);
+    else acceptedMessages.fetchAndAndRelaxed(~(1u << id));
+}
+
+bool ServerWorker::is_accepting(WireProtocol::MessageId id) const {
+    return acceptedMessages.loadRelaxed() & (1u << id);
+}
+
+qint64 ServerWorker::takeToken() {
+    // Returns 0 once a token is taken, otherwise how many ms until there is one
+    const uint64_t now = Metrics::now();
+    tokens = qMin<double>(RATE_LIMIT_BURST, tokens + double(now - tokensAt) * RATE_LIMIT_PER_SEC / 1e9);
+    tokensAt = now;
+    if (tokens >= 1) {
+        tokens -= 1;
+        return 0;
+    }
+    return qint64((1 - tokens) * 1000 / RATE_LIMIT_PER_SEC) + 1;
+}
+
+bool ServerWorker::setLocalDescriptor(qintptr socketDescriptor) {
+    channel = new ShmChannel(this);
+    connect(channel, &ShmChannel::readyRead, this, &ServerWorker::receiveJson);
+    connect(channel, &ShmChannel::writable, this, &ServerWorker::flushOutbound);
+    connect(channel, &ShmChannel::disconnected, this, &ServerWorker::disconnectedFromClient);
+    return channel->accept(socketDescriptor);
+}
+
+bool ServerWorker::isConnected() const {
+    return channel ? channel->isOpen() : serverSocket->state() == QAbstractSocket::ConnectedState;
+}
+
+void ServerWorker::abortConnection() {
+    if (channel) channel->close();
+    else serverSocket->abort();
+}
+
+qint64 ServerWorker::pendingFrameSize() {
+
+    // Returns the length of the next frame once all of it is here, otherwise -1
+    qint64 length;
+    if (channel) {
+        if (!channel->hasFrame()) return -1;
+        length = channel->nextFrameSize();
+    } else {
+        uchar prefix[4];
+        if (serverSocket->peek(reinterpret_cast<char*>(prefix), 4) < 4) return -1;
+        const quint32 announced = qFromBigEndian<quint32>(prefix);
+        length = announced == 0xFFFFFFFF ? 0 : qint64(announced); // QDataStream's null QByteArray
+    }
+    if (length > MAX_FRAME_BYTES) {
+        Metrics::add(COUNTER_FRAMES_OVERSIZED);
+        LOG_WARN(LOG_NET, "Disconnecting %s, sent a %lld byte frame", qPrintable(username), length);
+        abortConnection();
+        return -1;
+    }
+    if (!channel && serverSocket->bytesAvailable() < 4 + length) return -1;
+    return length;
+}
+
 void ServerWorker::receiveJson() {
 
-    QByteArray jsonData;
-    QDataStream socketStream(serverSocket);
-    socketStream.setVersion(QDataStream::Qt_5_7);
-
-    for (;;) {
-        socketStream.startTransaction();
-        socketStream >> jsonData;
-        if (socketStream.commitTransaction()) {
-            QJsonParseError parseError;
-            const QJsonDocument jsonDoc = QJsonDocument::fromJson(jsonData, &parseError);
-            if (parseError.error == QJsonParseError::NoError) {
-                if (jsonDoc.isObject()) {
-                    emit jsonReceived(jsonDoc.object());
-                } else {
-                    emit logMessage("Invalid json received: " + QString::fromUtf8(jsonData));
-                }
-            } else {
-                emit logMessage("Invalid json received: " + QString::fromUtf8(jsonData));
-            }
-        } else break;
-    }
-}
-
-void ServerWorker::sendJson(const QJsonObject &json) {
-
-    const QByteArray jsonData = QJsonDocument(json).toJson();
-    emit logMessage("Sending to " + username + ": " + QString::fromUtf8(jsonData));
-    QDataStream socketStream(serverSocket);
-    socketStream.setVersion(QDataStream::Qt_5_7);
-    socketStream << jsonData;
+    // Frames are read by hand rather than through QDataStream so the length is checked
+    // before anything is allocated for it
+    while (!throttled && isConnected()) {
+
+        const qint64 length = pendingFrameSize();
+        if (length < 0) return;
+
+        // Out of tokens, leave the rest buffered and come back when there is one
+        const qint64 wait = takeToken();
+        if (wait) {
+            Metrics::add(COUNTER_RATE_LIMITED);
+            LOG_DEBUG(LOG_NET, "Pausing reads from %s for %lld ms", qPrintable(username), wait);
+            throttled = true;
+            QTimer::singleShot(int(wait), this, [this]() {
+                throttled = false;
+                receiveJson();
+            });
+            return;
+        }
+
+        // A frame in shared memory is decoded where it lies and only then let go of
+        if (channel) {
+            receiveFrame(channel->peekFrame());
+            channel->skipFrame();
+            continue;
+        }
+        serverSocket->skip(4);
+        receiveFrame(serverSocket->read(length));
+    }
+}
+
+void ServerWorker::receiveFrame(const QByteArray &jsonData) {
+
+    Metrics::add(COUNTER_FRAMES_IN);
+    Metrics::add(COUNTER_BYTES_IN, uint64_t(jsonData.size()));
 
+    // The type is read without decoding, so a frame that is turned away costs next to nothing
+    const WireProtocol::MessageId peeked = WireProtocol::peekMessageId(jsonData);
+    if (peeked == WireProtocol::UNKNOWN) {
+        Metrics::add(COUNTER_DECODE_ERRORS);
+        LOG_WARN(LOG_PROTOCOL, "Invalid message received (%d bytes)", int(jsonData.size()));
+        return;
+    }
+    if (!is_accepting(peeked)) {
+        Metrics::add(COUNTER_FRAMES_REJECTED);
+        LOG_DEBUG(LOG_PROTOCOL, "Rejected %s from %s", qPrintable(WireProtocol::messageType(peeked)), qPrintable(username));
+        return;
+    }
+
+    const uint64_t decodeStart = Metrics::now();
+    AnyMessage message;
+    bool decoded;
+    {
+        TRACE_SCOPE_ARG("protocol", "decode", "bytes", jsonData.size());
+        decoded = WireProtocol::decode(jsonData, message);
+    }
+    // A JSON frame that repeats its "type" could decode as something other than what was peeked
+    if (!decoded || WireProtocol::messageId(message) != peeked) {
+        Metrics::add(COUNTER_DECODE_ERRORS);
+        LOG_WARN(LOG_PROTOCOL, "Invalid message received (%d bytes)", int(jsonData.size()));
+        return;
+    }
+    Metrics::recordSince(STAGE_DECODE, decodeStart);
+
+    // Protocol negotiation stays on this connection, the reply is always JSON. A client on an
+    // older binary version gets JSON, its frames would be missing fields
+    if (const HelloMessage *hello = get_if<HelloMessage>(&message)) {
+        wireVersion.storeRelaxed(hello->binary_version >= WIRE_PROTOCOL_VERSION ? WIRE_PROTOCOL_VERSION : 0);
+        HelloMessage reply;
+        reply.binary_version = get_wire_version();
+        sendFrame(encodeFrame(reply, 0));
+        return;
+    }
+
+    emit messageReceived(message);
+}
+
+void ServerWorker::sendMessage(const AnyMessage &message) {
+
+    const QByteArray frame = encodeFrame(message, get_wire_version());
+    LOG_DEBUG(LOG_PROTOCOL, "Sending %s to %s (%d bytes)", qPrintable(WireProtocol::messageType(WireProtocol::messageId(message))), qPrintable(username), int(frame.size()));
+    sendFrame(frame);
+
+}
+
+void ServerWorker::sendFrame(const QByteArray &frame, FrameKind kind) {
+
+    if (!isConnected()) return;
+
+    // The client could not apply this on top of the deltas already dropped
+    if (kind == FRAME_DELTA && needsSnapshot) {
+        Metrics::add(COUNTER_FRAMES_DROPPED);
+        return;
+    }
+    if (kind == FRAME_SNAPSHOT) {
+        dropQueued(true);
+        needsSnapshot = false;
+        snapshotRequested = false;
+    }
+    outbound.enqueue({frame, kind, Metrics::now()});
+    queuedBytes += frame.size();
+
+    if (queuedBytes > MAX_QUEUED_BYTES || outbound.size() > MAX_QUEUED_FRAMES) {
+        // Shed state updates first, a GAME_STATE goes out in their place once the queue drains
+        dropQueued(false);
+        if (queuedBytes > MAX_QUEUED_BYTES || outbound.size() > MAX_QUEUED_FRAMES) {
+            Metrics::add(COUNTER_SLOW_CLIENTS);
+            LOG_WARN(LOG_NET, "Disconnecting %s, %d frames (%lld bytes) unsent", qPrintable(username), int(outbound.size()), queuedBytes);
+            outbound.clear();
+            queuedBytes = 0;
+            abortConnection();
+            return;
+        }
+    }
+
+    scheduleFlush();
+}
+
+void ServerWorker::scheduleFlush() {
+    // Everything sent during this pass of the event loop goes out together on the next one
+    if (flushScheduled) return;
+    flushScheduled = true;
+    QMetaObject::invokeMethod(this, &ServerWorker::flushOutbound, Qt::QueuedConnection);
+}
+
+void ServerWorker::flushOutbound() {
+
+    flushScheduled = false;
+    if (channel) flushChannel();
+    else flushSocket();
+
+    // The client has caught up with what was left after deltas were dropped, bring its state up to date
+    if (needsSnapshot && !snapshotRequested && outbound.isEmpty()) {
+        snapshotRequested = true;
+        emit snapshotNeeded();
+    }
+}
+
+void ServerWorker::flushSocket() {
+
+    // Keep the socket's own buffer short so that the limits above are what bounds memory
+    const qint64 room = SOCKET_WRITE_HIGH_WATER - serverSocket->bytesToWrite();
+    if (outbound.isEmpty() || room <= 0) return;
+
+    // QTcpSocket sends each buffer it was given with its own system call and has no vectored
+    // write, so frames are joined into one buffer. A lone frame is passed on without a copy
+    const uint64_t start = Metrics::now();
+    QueuedFrame queued = takeQueued(start);
+    if (outbound.isEmpty() || queued.frame.size() + outbound.head().frame.size() > room) {
+        writeBatch(queued.frame, 1, start);
+        return;
+    }
+
+    QByteArray batch;
+    batch.reserve(int(qMin<qint64>(room, queuedBytes + queued.frame.size())));
+    batch.append(queued.frame);
+    int frames = 1;
+    while (!outbound.isEmpty() && batch.size() + outbound.head().frame.size() <= room) {
+        batch.append(takeQueued(start).frame);
+        frames++;
+    }
+    writeBatch(batch, frames, start);
+}
+
+void ServerWorker::flushChannel() {
+
+    // Each frame is copied straight into the ring, so there is nothing to gain from joining them.
+    // What does not fit waits for writable()
+    const uint64_t start = Metrics::now();
+    int frames = 0;
+    qint64 bytes = 0;
+    while (!outbound.isEmpty() && channel->writeFrame(outbound.head().frame)) {
+        bytes += takeQueued(start).frame.size();
+        frames++;
+    }
+    if (!frames) return;
+    channel->flush();
+    Metrics::recordSince(STAGE_WRITE, start);
+    Metrics::add(COUNTER_WRITES);
+    Metrics::add(COUNTER_FRAMES_OUT, uint64_t(frames));
+    Metrics::add(COUNTER_BYTES_OUT, uint64_t(bytes));
+}
+
+ServerWorker::QueuedFrame ServerWorker::takeQueued(uint64_t now) {
+    QueuedFrame queued = outbound.dequeue();
+    queuedBytes -= queued.frame.size();
+    Metrics::record(STAGE_WRITE_QUEUE, now - queued.queuedAt);
+    return queued;
+}
+
+void ServerWorker::writeBatch(const QByteArray &batch, int frames, uint64_t start) {
+    TRACE_SCOPE_ARG("net", "socket_write", "frames", frames);
+    serverSocket->write(batch);
+    Metrics::recordSince(STAGE_WRITE, start);
+    Metrics::add(COUNTER_WRITES);
+    Metrics::add(COUNTER_FRAMES_OUT, uint64_t(frames));
+    Metrics::add(COUNTER_BYTES_OUT, uint64_t(batch.size()));
+}
+
+void ServerWorker::dropQueued(bool snapshots) {
+    int dropped = 0;
+    for (auto it = outbound.begin(); it != outbound.end();) {
+        if (it->kind == FRAME_DELTA || (snapshots && it->kind == FRAME_SNAPSHOT)) {
+            queuedBytes -= it->frame.size();
+            it = outbound.erase(it);
+            dropped++;
+        } else {
+            ++it;
+        }
+    }
+    if (dropped && !snapshots) needsSnapshot = true;
+    if (dropped) Metrics::add(COUNTER_FRAMES_DROPPED, uint64_t(dropped));
+    if (dropped) LOG_DEBUG(LOG_NET, "Dropped %d state frames queued for %s", dropped, qPrintable(username));
 }
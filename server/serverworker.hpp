@@ -2,9 +2,45 @@
 
 #include <QObject>
 #include <QTcpSocket>
-#include <QJsonObject>
+#include <QAtomicInt>
+#include <QQueue>
+#include "wireprotocol.hpp"
+#include "messages.hpp"
+#include "shmchannel.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 using namespace std;
 
+// Limits on what may be waiting for a client that is not reading fast enough
+#define MAX_QUEUED_BYTES (1 << 20)
+#define MAX_QUEUED_FRAMES 512
+// Frames only leave the queue while the socket buffer is below this
+#define SOCKET_WRITE_HIGH_WATER (64 * 1024)
+
+// Nothing a client sends comes close to this, a longer frame is not read at all
+#define MAX_FRAME_BYTES 4096
+// Frames a client may send per second, and in one burst, before its reads are paused
+#define RATE_LIMIT_PER_SEC 20
+#define RATE_LIMIT_BURST 40
+// Unread bytes kept for a connection, past this TCP holds the client back
+#define SOCKET_READ_BUFFER (64 * 1024)
+
+// How a queued frame can be treated when the client falls behind
+enum FrameKind {
+    FRAME_MESSAGE,  // always delivered
+    FRAME_DELTA,    // STATE_DELTA, can be dropped, the client is then sent a GAME_STATE once it has caught up
+    FRAME_SNAPSHOT  // GAME_STATE, supersedes every state frame queued before it
+};
+
+// WireProtocol::frame(WireProtocol::encode(...)), timed as STAGE_ENCODE
+inline QByteArray encodeFrame(const AnyMessage &message, int version) {
+    TRACE_SCOPE_ARG("protocol", "encode", "version", version);
+    const uint64_t start = Metrics::now();
+    QByteArray frame = WireProtocol::frame(WireProtocol::encode(message, version));
+    Metrics::recordSince(STAGE_ENCODE, start);
+    return frame;
+}
+
 class ServerWorker : public QObject
 {
     Q_OBJECT
@@ -13,20 +49,64 @@ class ServerWorker : public QObject
 public:
     explicit ServerWorker(QObject *parent = nullptr);
     virtual bool setSocketDescriptor(qintptr socketDescriptor);
+    // A connection accepted on the local server, frames then go through shared memory instead
+    bool setLocalDescriptor(qintptr socketDescriptor);
     QString get_username() const;
     void set_username(const QString &userName);
-    void sendJson(const QJsonObject &jsonData);
+    void sendMessage(const AnyMessage &message);
+    // Queues an already framed message, see WireProtocol::frame. The buffer is shared, not copied.
+    // A client that stays over the queue limits once state frames are dropped is disconnected
+    void sendFrame(const QByteArray &frame, FrameKind kind = FRAME_MESSAGE);
+    int get_wire_version() const;
+    // Frames of a type the connection may not send are dropped before they reach the table,
+    // binary ones without being decoded. PLAYER_ACTION is only accepted while the table
+    // grants it. Called from any thread
+    void set_accepting(WireProtocol::MessageId id, bool accepting);
+    bool is_accepting(WireProtocol::MessageId id) const;
 
 signals:
-    void jsonReceived(const QJsonObject &jsonDoc);
+    void messageReceived(const AnyMessage &message);
+    // State deltas were dropped and the queue has since drained, the client needs a GAME_STATE
+    void snapshotNeeded();
     void disconnectedFromClient();
     void error();
-    void logMessage(const QString &msg);
 public slots:
     void disconnectFromClient();
 private slots:
     void receiveJson();
+    void flushOutbound();
 private:
+    bool isConnected() const;
+    void abortConnection();
+    qint64 pendingFrameSize();
+    void receiveFrame(const QByteArray &jsonData);
+    struct QueuedFrame {
+        QByteArray frame;
+        FrameKind kind;
+        uint64_t queuedAt; // Metrics::now() when queued
+    };
+    QueuedFrame takeQueued(uint64_t now);
+    void writeBatch(const QByteArray &batch, int frames, uint64_t start);
+    void dropQueued(bool snapshots);
+    void scheduleFlush();
+    void flushSocket();
+    void flushChannel();
+    qint64 takeToken();
+
     QTcpSocket *serverSocket;
+    ShmChannel *channel = nullptr; // set for local connections, serverSocket is then unused
+    QQueue<QueuedFrame> outbound;
+    qint64 queuedBytes = 0;
+    bool flushScheduled = false; // a flush is already posted for this event loop pass
+    bool needsSnapshot = false;  // deltas were dropped, later ones are useless until a GAME_STATE is queued
+    bool snapshotRequested = false; // snapshotNeeded() has gone out for the deltas dropped
     QString username;
+    QAtomicInt wireVersion; // binary protocol version agreed through HELLO, 0 for JSON, read by the table thread
+    QAtomicInteger<quint32> acceptedMessages; // bit per WireProtocol::MessageId
+    static_assert(WireProtocol::NUM_MESSAGE_IDS <= 32, "acceptedMessages has a bit per message id");
+
+    // Token bucket for incoming frames, refilled at RATE_LIMIT_PER_SEC up to RATE_LIMIT_BURST
+    double tokens = RATE_LIMIT_BURST;
+    uint64_t tokensAt; // Metrics::now() of the last refill
+    bool throttled = false; // reads are paused until the bucket has a token again
 };
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <QDeadlineTimer>
+#include <QQueue>
+#include <QAtomicInt>
+
+#include "engine.hpp"
+#include "publicstate.hpp"
+#include "wireprotocol.hpp"
+#include "timerwheel.hpp"
+#include "housebots.hpp"
+using namespace std;
+
+// How long a dropped player's seat is held for them to resume
+#define RESUME_GRACE_MS 30000
+// Recent table events kept for replay to a client that resumes
+#define TABLE_EVENT_HISTORY 256
+// Time a seat has to act, then its time bank, before it is checked or folded for it
+#define ACTION_TIME_MS 15000
+#define TIME_BANK_MS 30000
+// Resolution of the action clocks
+#define CLOCK_TICK_MS 50
+
+class IoShard;
+class ServerWorker;
+
+// What the server knows about a connection. The seat is bound when the table accepts
+// the join, and every later message from the connection acts as that seat.
+struct Session {
+    IoShard *shard = nullptr;
+    QString username;
+    int tableId = -1;
+    int seat = -1; // playerID at the table, -1 until seated
+    QString resumeToken;
+};
+
+// A seat that a client can take back with its resume token, issued when it joins
+struct SeatHold {
+    int tableId;
+    int seat;
+    QString username;
+    ServerWorker *connection = nullptr; // nullptr while the client is away
+    QDeadlineTimer expiry;              // when the seat is given up if the client has not resumed
+};
+
+// One game and the connections that receive its broadcasts. Only used on the table thread
+struct Table {
+    int id;
+    Engine *engine;
+    QVector<ServerWorker*> members; // every connection at this table, broadcasts go to these only
+    QVector<ServerWorker*> seats;   // connection for each playerID, nullptr once it has gone
+    QVector<SeatedBot*> houseBots;  // house bot for each playerID, nullptr for seats played over the network
+    int houseBotGame = -1;          // last game the house bots were told had started
+
+    // Last state pushed to the members, and its version. Clients apply STATE_DELTAs in
+    // version order and ask for a full GAME_STATE when they see a gap.
+    PublicState pushedState;
+    quint32 stateVersion = 0;
+    qint64 pushedGameVersion = -1; // GameState version pushedState was captured from
+
+    // Encoded GAME_STATE for stateVersion, one per wire version, built on first request
+    QByteArray stateFrames[WIRE_PROTOCOL_VERSION + 1];
+
+    // Broadcast events stamped with a sequence number (seq), oldest first, so that a
+    // client that resumes can be sent what it missed
+    quint32 eventSeq = 0;
+    QQueue<AnyMessage> events;
+
+    // Spectators across all I/O shards, kept by the shards. Spectators are not members,
+    // the shards fan out what the table publishes to them, and nothing is published while this is 0
+    QAtomicInt spectators;
+
+    // Clock for the seat to act, on the server's timer wheel. A turn is identified by the
+    // seat and the game version it started at, since a seat can act twice in a row across rounds
+    TimerNode clock;
+    int clockSeat = -1;
+    quint64 clockVersion = 0;
+    bool onTimeBank = false;
+    quint64 timeBankStart = 0;  // wheel tick the time bank started running
+    QVector<int> timeBanks;     // ms left for each playerID, spent only once ACTION_TIME_MS is up
+};
@@ -0,0 +1,57 @@
+#include "statsserver.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+// Anything longer than this is not a scrape request
+#define STATS_MAX_REQUEST 4096
+
+StatsServer::StatsServer(QObject *parent) : QTcpServer(parent) {}
+
+bool StatsServer::startServer(quint16 port, const QHostAddress &address) {
+    return listen(address, port);
+}
+
+void StatsServer::incomingConnection(qintptr socketDescriptor) {
+    QTcpSocket *socket = new QTcpSocket(this);
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        delete socket;
+        return;
+    }
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { respond(socket); });
+    connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+}
+
+void StatsServer::respond(QTcpSocket *socket) {
+
+    // Wait for the whole header, the request line is all that matters
+    const QByteArray request = socket->peek(STATS_MAX_REQUEST);
+    if (!request.contains("\r\n\r\n") && request.size() < STATS_MAX_REQUEST) return;
+    socket->readAll();
+
+    const QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    const QByteArray path = requestLine.size() >= 2 && requestLine[0] == "GET" ? requestLine[1] : QByteArray();
+
+    bool found = true;
+    QByteArray contentType = "text/plain; version=0.0.4";
+    QByteArray body;
+    if (path == "/metrics" || path == "/") {
+        body = QByteArray::fromStdString(Metrics::prometheus());
+    } else if (path == "/trace/start") {
+        Trace::start();
+        body = "Tracing\n";
+    } else if (path == "/trace/stop") {
+        Trace::stop();
+        contentType = "application/json";
+        body = QByteArray::fromStdString(Trace::json());
+    } else {
+        found = false;
+        body = "Not found\n";
+    }
+
+    QByteArray response = found ? QByteArrayLiteral("HTTP/1.0 200 OK\r\n") : QByteArrayLiteral("HTTP/1.0 404 Not Found\r\n");
+    response += "Content-Type: " + contentType + "\r\nContent-Length: " + QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n";
+    response += body;
+
+    socket->write(response);
+    socket->disconnectFromHost();
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+using namespace std;
+
+// Plain HTTP endpoint that answers GET /metrics with Metrics::prometheus(), and turns
+// tracing on with GET /trace/start and off with GET /trace/stop, which returns the trace.
+// It only listens on the loopback interface and serves one short request per connection
+class StatsServer : public QTcpServer
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(StatsServer)
+public:
+    explicit StatsServer(QObject *parent = nullptr);
+    bool startServer(quint16 port, const QHostAddress &address = QHostAddress::LocalHost);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    void respond(QTcpSocket *socket);
+};
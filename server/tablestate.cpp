@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <stdexcept>
+#include "tablestate.hpp"
+#include "zobrist.hpp"
+using namespace std;
+
+void TableState::init(int new_num_players, int init_stack) {
+    num_players = new_num_players;
+    round = PREFLOP;
+    pot = 0;
+    board.clear();
+    for (int i = 0; i < MAXPLAYERS; ++i) {
+        stack[i] = i < num_players ? init_stack : 0;
+        to_call[i] = 0;
+        contributed[i] = 0;
+        hole_cards[i].clear();
+    }
+    seated_mask = seat_bit(num_players) - 1;
+    active_mask = seated_mask;
+    acted_mask = 0;
+    allin_mask = 0;
+    current_player_index = -1;
+    dealer_index = -1;
+    sb_index = -1;
+    bb_index = -1;
+    last_raiser_index = -1;
+    rehash();
+}
+
+int TableState::seat_player(int init_stack) {
+    SeatMask free = ~(seated_mask | active_mask) & (seat_bit(MAXPLAYERS) - 1);
+    if (!free) return -1;
+    int index = lowest_seat(free);
+    // A seat never used before is not in the hash yet, one that was left already is
+    if (index >= num_players) {
+        num_players = index + 1;
+        hash ^= zobrist_keys.stack[index][zobrist_stack_bucket(stack[index])];
+    }
+    set_stack(index, init_stack);
+    to_call[index] = 0;
+    contributed[index] = 0;
+    hash ^= zobrist_cards(zobrist_keys.hole_cards[index], hole_cards[index]);
+    hole_cards[index].clear();
+    seated_mask |= seat_bit(index);
+    return index;
+}
+void TableState::unseat_player(int index) {
+    SeatMask bit = seat_bit(index);
+    if (!(seated_mask & bit)) return;
+    seated_mask &= ~bit;
+    if (!(active_mask & bit)) set_stack(index, 0);
+}
+
+void TableState::rehash() {
+    hash = zobrist_keys.round[round] ^ zobrist_cards(zobrist_keys.board, board);
+    for (int i = 0; i < num_players; ++i) {
+        hash ^= zobrist_keys.stack[i][zobrist_stack_bucket(stack[i])];
+        hash ^= zobrist_cards(zobrist_keys.hole_cards[i], hole_cards[i]);
+    }
+    if (current_player_index >= 0) hash ^= zobrist_keys.current_player[current_player_index];
+    num_actions = 0;
+}
+void TableState::hash_action(int index, const Action& action) {
+    hash ^= zobrist_keys.action[num_actions % ZOBRIST_MAX_PLY][index][action.type];
+    if (action.type == RAISE) hash ^= zobrist_keys.amount[zobrist_amount_bucket(action.amount)];
+    num_actions++;
+}
+void TableState::set_stack(int index, int new_stack) {
+    hash ^= zobrist_keys.stack[index][zobrist_stack_bucket(stack[index])];
+    stack[index] = new_stack;
+    hash ^= zobrist_keys.stack[index][zobrist_stack_bucket(stack[index])];
+}
+void TableState::set_current_player(int index) {
+    if (current_player_index >= 0) hash ^= zobrist_keys.current_player[current_player_index];
+    current_player_index = index;
+    if (current_player_index >= 0) hash ^= zobrist_keys.current_player[current_player_index];
+}
+
+SeatStatus TableState::get_status(int index) const {
+    SeatMask bit = seat_bit(index);
+    if (!(seated_mask & bit)) return EMPTY;
+    if (!(active_mask & bit)) return FOLDED;
+    if (allin_mask & bit) return ALLIN;
+    return ACTIVE;
+}
+
+int TableState::next_in(SeatMask mask, int index) const {
+    if (!mask) return index;
+    SeatMask after = index < 0 ? mask : mask & ~((seat_bit(index) << 1) - 1);
+    return after ? lowest_seat(after) : lowest_seat(mask);
+}
+int TableState::prev_in(SeatMask mask, int index) const {
+    if (!mask) return index;
+    SeatMask before = mask & (seat_bit(index) - 1);
+    return before ? highest_seat(before) : highest_seat(mask);
+}
+
+void TableState::set_dealer_sb_bb() {
+    dealer_index = next_in_hand(dealer_index);
+    sb_index = next_in_hand(dealer_index);
+    bb_index = next_in_hand(sb_index);
+}
+void TableState::next_player() {
+    set_current_player(next_in(to_act_mask(), current_player_index));
+}
+void TableState::next_round() {
+    hash ^= zobrist_keys.round[round];
+    round = static_cast<Round>((round + 1) % 4);
+    hash ^= zobrist_keys.round[round];
+    set_current_player(next_in(to_act_mask(), dealer_index));
+    last_raiser_index = -1;
+    acted_mask = 0;
+}
+void TableState::deal_to_board(const Card& card) {
+    if (board.contains(card)) return;
+    board.add(card);
+    hash ^= zobrist_keys.board[card.to_index()];
+}
+void TableState::deal_hole_cards(int index, const Card& first, const Card& second) {
+    hash ^= zobrist_cards(zobrist_keys.hole_cards[index], hole_cards[index]);
+    hole_cards[index].clear();
+    hole_cards[index].add(first);
+    hole_cards[index].add(second);
+    hash ^= zobrist_cards(zobrist_keys.hole_cards[index], hole_cards[index]);
+}
+void TableState::award(int index, int amount) {
+    set_stack(index, stack[index] + amount);
+}
+
+bool TableState::betting_over() const {
+    if (num_in_hand() == 1) return true;
+    SeatMask can_act = to_act_mask();
+    // Nobody left to bet against
+    if (seat_count(can_act) <= 1 && (!can_act || to_call[lowest_seat(can_act)] == 0)) return true;
+    return (can_act & ~acted_mask) == 0;
+}
+bool TableState::game_end() const {
+    if (num_in_hand() == 1) return true;
+    if (round == RIVER && betting_over()) return true;
+    return false;
+}
+
+LegalActions TableState::legal_actions() const {
+    LegalActions legal = {0, 0, 0, 0};
+    int index = current_player_index;
+    if (index < 0 || !(to_act_mask() & seat_bit(index)) || betting_over()) return legal;
+
+    legal.call_amount = to_call[index];
+    legal.mask |= action_bit(FOLD);
+    legal.mask |= action_bit(legal.call_amount == 0 ? CHECK : CALL);
+
+    // Raises need chips left over after calling, and are at least the bigger of the call and the BB
+    int behind = stack[index] - legal.call_amount;
+    if (behind > 0) {
+        legal.mask |= action_bit(RAISE);
+        legal.max_raise = behind;
+        legal.min_raise = min(max(legal.call_amount, BIGBLIND), behind);
+    }
+    return legal;
+}
+
+int TableState::start_hand() {
+    round = PREFLOP;
+    pot = 0;
+    board.clear();
+    active_mask = 0;
+    for (int i = 0; i < num_players; ++i) {
+        if (!(seated_mask & seat_bit(i))) stack[i] = 0;
+        if (stack[i] > 0) active_mask |= seat_bit(i);
+        to_call[i] = 0;
+        contributed[i] = 0;
+        hole_cards[i].clear();
+    }
+    acted_mask = 0;
+    allin_mask = 0;
+
+    int players_still_in = num_in_hand();
+    if (players_still_in < 2) {
+        rehash();
+        return players_still_in;
+    }
+
+    set_dealer_sb_bb();
+    current_player_index = next_in_hand(dealer_index);
+    last_raiser_index = -1;
+
+    rehash();
+    return players_still_in;
+}
+void TableState::post_blind(int amount) {
+    // Blinds do not count as acting, so the BB still gets the option to check or raise
+    hash_action(current_player_index, Action(RAISE, amount));
+    raise(amount);
+    acted_mask = 0;
+    next_player();
+}
+
+int TableState::bet(int index, int amount) {
+    int paid = min(amount, stack[index]);
+    set_stack(index, stack[index] - paid);
+    contributed[index] += paid;
+    update_allin(index);
+    return paid;
+}
+void TableState::update_allin(int index) {
+    if (stack[index] == 0) allin_mask |= seat_bit(index);
+}
+void TableState::set_to_call(int index, int new_to_call) {
+    to_call[index] = min(new_to_call, stack[index]);
+}
+void TableState::raise(int amount) {
+    int index = current_player_index;
+    pot += bet(index, to_call[index] + amount);
+    to_call[index] = 0;
+    last_raiser_index = index;
+    acted_mask = 0;
+    for (SeatMask others = active_mask & ~seat_bit(index); others; others &= others - 1) {
+        int i = lowest_seat(others);
+        set_to_call(i, to_call[i] + amount);
+    }
+}
+
+int TableState::make_action(const Action& action) {
+
+    if (!legal_actions().allows(action)) return -1;
+
+    int index = current_player_index;
+
+    switch (action.type) {
+    case FOLD:
+        active_mask &= ~seat_bit(index);
+        hash ^= zobrist_cards(zobrist_keys.hole_cards[index], hole_cards[index]);
+        hole_cards[index].clear();
+        break;
+    case CALL:
+        pot += bet(index, to_call[index]);
+        to_call[index] = 0;
+        break;
+    case RAISE:
+        raise(action.amount);
+        break;
+    case CHECK:
+        break;
+    default:
+        throw invalid_argument("Invalid action type");
+    }
+    acted_mask |= seat_bit(index);
+    hash_action(index, action);
+
+    next_player();
+    return 0;
+}
+
+int TableState::make_action(const Action& action, TableState& undo) {
+    undo = *this;
+    return make_action(action);
+}
+void TableState::unmake_action(const TableState& undo) {
+    *this = undo;
+}
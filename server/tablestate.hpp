@@ -0,0 +1,175 @@
+#pragma once
+#include <cstdint>
+#include <type_traits>
+#include "cards.hpp"
+using namespace std;
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define SMALLBLIND 1
+#define BIGBLIND 2
+#define INITIALSTACK 200
+
+#define MAXPLAYERS 6
+
+enum Round { PREFLOP, FLOP, TURN, RIVER };
+
+enum ActionType { FOLD, CALL, RAISE, CHECK };
+
+struct Action {
+    ActionType type;
+    int amount; // for raise only
+    Action(ActionType new_type, int new_amount) : type(new_type), amount(new_amount) {}
+};
+
+// One bit per seat, bit i is the player with playerID i
+typedef uint32_t SeatMask;
+
+inline SeatMask seat_bit(int index) { return SeatMask(1) << index; }
+
+inline int seat_count(SeatMask mask) {
+#if defined(_MSC_VER)
+    return int(__popcnt(mask));
+#else
+    return __builtin_popcount(mask);
+#endif
+}
+// PRE: mask must not be empty
+inline int lowest_seat(SeatMask mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return int(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+inline int highest_seat(SeatMask mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return int(index);
+#else
+    return 31 - __builtin_clz(mask);
+#endif
+}
+
+enum SeatStatus { EMPTY, ACTIVE, FOLDED, ALLIN };
+
+inline uint8_t action_bit(ActionType type) { return uint8_t(1) << type; }
+
+// What the player to act is allowed to do. Raise amounts are on top of the call,
+// and a raise below min_raise is only allowed when it puts the player all in.
+struct LegalActions {
+    uint8_t mask; // one action_bit per allowed ActionType
+    int call_amount;
+    int min_raise;
+    int max_raise;
+
+    bool can(ActionType type) const { return mask & action_bit(type); }
+    bool allows(const Action& action) const {
+        if (!can(action.type)) return false;
+        if (action.type == RAISE) return action.amount >= min_raise && action.amount <= max_raise;
+        return true;
+    }
+};
+
+// Betting state of a single table, held in fixed-size arrays and seat bitmasks so
+// that it can be copied with a memcpy. GameState runs its rules through this struct, and bots
+// or solvers can take a snapshot of it and search the action tree directly:
+//
+//     TableState undo;
+//     state.make_action(action, undo);
+//     ... search ...
+//     state.unmake_action(undo);
+//
+struct TableState {
+    int num_players;
+    Round round;
+    int pot;
+    CardSet board;
+
+    // Per-seat state, indexed by playerID
+    int stack[MAXPLAYERS];
+    int to_call[MAXPLAYERS];
+    int contributed[MAXPLAYERS]; // chips put into the pot this hand
+    CardSet hole_cards[MAXPLAYERS];
+
+    SeatMask seated_mask; // seats with a player
+    SeatMask active_mask; // seats still in the hand, including all-in seats
+    SeatMask acted_mask;  // seats that have acted since the last raise
+    SeatMask allin_mask;  // seats in the hand with no chips left behind
+
+    int current_player_index;
+    int dealer_index;
+    int sb_index;
+    int bb_index;
+    int last_raiser_index;
+
+    // Zobrist hash of the board, round, bucketed stacks, hole cards, player to act
+    // and the actions taken this hand, kept up to date as the state changes
+    uint64_t hash;
+    int num_actions;
+
+    void init(int new_num_players, int init_stack);
+    // Seats a player in the lowest empty seat and returns its index, or -1 if the table is full.
+    // The seat is dealt in from the next hand
+    int seat_player(int init_stack);
+    // Empties a seat. A seat still in the hand stays in it until it folds, its chips leave
+    // with it when the next hand starts. The seat can be taken again once it is out of the hand
+    void unseat_player(int index);
+
+    SeatStatus get_status(int index) const;
+    bool has_folded(int index) const { return !(active_mask & seat_bit(index)); }
+    bool has_acted(int index) const { return acted_mask & seat_bit(index); }
+
+    // Seats still in the hand that can still bet
+    SeatMask to_act_mask() const { return active_mask & ~allin_mask; }
+
+    // First seat of mask walking clockwise (next) or anticlockwise (prev) from index
+    int next_in(SeatMask mask, int index) const;
+    int prev_in(SeatMask mask, int index) const;
+    int next_in_hand(int index) const { return next_in(active_mask, index); }
+    int prev_in_hand(int index) const { return prev_in(active_mask, index); }
+    int num_in_hand() const { return seat_count(active_mask); }
+
+    void set_dealer_sb_bb();
+    void next_player();
+    void next_round();
+    void deal_to_board(const Card& card);
+    void deal_hole_cards(int index, const Card& first, const Card& second);
+    void award(int index, int amount);
+
+    bool betting_over() const;
+    bool game_end() const;
+
+    // Every check on an action happens here, make_action rejects anything this does not allow
+    LegalActions legal_actions() const;
+
+    // Resets the seats for a new hand and moves the button, returns the number of seats dealt in
+    int start_hand();
+    // Forced bet for the current player which is not subject to the min raise
+    void post_blind(int amount);
+
+    // Returns -1 and leaves the state untouched if the action is not allowed
+    int make_action(const Action& action);
+
+    // Same as above, but saves the previous state into undo so that it can be restored
+    int make_action(const Action& action, TableState& undo);
+    void unmake_action(const TableState& undo);
+
+private:
+    void rehash();
+    void hash_action(int index, const Action& action);
+    void set_stack(int index, int new_stack);
+    void set_current_player(int index);
+    // Moves up to amount from the stack into the pot, and marks the seat all in if that empties it
+    int bet(int index, int amount);
+    void update_allin(int index);
+    void set_to_call(int index, int new_to_call);
+    void raise(int amount);
+};
+
+static_assert(is_trivially_copyable<TableState>::value, "TableState must stay cheap to copy");
@@ -0,0 +1,89 @@
+#include "timerwheel.hpp"
+
+void TimerNode::cancel() {
+    if (!next) return;
+    prev->next = next;
+    next->prev = prev;
+    prev = nullptr;
+    next = nullptr;
+}
+
+TimerWheel::TimerWheel(uint64_t now) : current(now) {
+    for (auto& level : slots) {
+        for (TimerNode& head : level) head.prev = head.next = &head;
+    }
+}
+
+TimerWheel::~TimerWheel() {
+    // Leave the timers unarmed so their owners can still cancel or destroy them
+    for (auto& level : slots) {
+        for (TimerNode& head : level) {
+            TimerNode* node = head.next;
+            while (node != &head) {
+                TimerNode* following = node->next;
+                node->prev = node->next = nullptr;
+                node = following;
+            }
+            head.prev = head.next = &head;
+        }
+    }
+}
+
+uint64_t TimerWheel::now() const {
+    return current;
+}
+
+void TimerWheel::schedule(TimerNode* node, uint64_t delay) {
+    node->cancel();
+    node->expiry = current + (delay ? delay : 1);
+    insert(node);
+}
+
+void TimerWheel::insert(TimerNode* node) {
+    // Level l holds timers due within 2^(8(l+1)) ticks, in the slot for their expiry's l-th byte
+    const uint64_t delta = node->expiry - current;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (uint64_t(1) << (TIMER_WHEEL_BITS * (level + 1)))) level++;
+    if (level == TIMER_WHEEL_LEVELS - 1 && delta >> (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) {
+        node->expiry = current + (uint64_t(1) << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+    }
+    const int slot = int((node->expiry >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1));
+
+    TimerNode& head = slots[level][slot];
+    node->prev = head.prev;
+    node->next = &head;
+    head.prev->next = node;
+    head.prev = node;
+}
+
+void TimerWheel::cascade(int level, int slot) {
+    // Move every timer in the slot down, they are now close enough for a finer level
+    TimerNode& head = slots[level][slot];
+    TimerNode* node = head.next;
+    head.prev = head.next = &head;
+    while (node != &head) {
+        TimerNode* following = node->next;
+        insert(node);
+        node = following;
+    }
+}
+
+void TimerWheel::advance(uint64_t now) {
+    while (current < now) {
+        current++;
+
+        // Entering a new block of a level pulls that block's timers down from it
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; ++level) {
+            if (current & ((uint64_t(1) << (TIMER_WHEEL_BITS * level)) - 1)) break;
+            cascade(level, int((current >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)));
+        }
+
+        // Callbacks can arm or cancel any timer, including others in this slot
+        TimerNode& head = slots[0][current & (TIMER_WHEEL_SLOTS - 1)];
+        while (head.next != &head) {
+            TimerNode* node = head.next;
+            node->cancel();
+            if (node->callback) node->callback();
+        }
+    }
+}
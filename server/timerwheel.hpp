@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+using namespace std;
+
+// 4 levels of 256 slots cover 2^32 ticks, later timers fire at the end of that range
+#define TIMER_WHEEL_BITS 8
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+// A timer lives inside whatever owns it, so arming and cancelling only relink it.
+// The callback is set once, it runs on the wheel's thread and may re-arm the timer
+struct TimerNode {
+    TimerNode* prev = nullptr;
+    TimerNode* next = nullptr;
+    uint64_t expiry = 0; // tick it fires on
+    function<void()> callback;
+
+    TimerNode() = default;
+    TimerNode(const TimerNode&) = delete;
+    TimerNode& operator=(const TimerNode&) = delete;
+    ~TimerNode() { cancel(); }
+
+    bool armed() const { return next != nullptr; }
+    void cancel();
+};
+
+// Hierarchical timing wheel: O(1) to arm or cancel, and each timer is moved down a level
+// at most TIMER_WHEEL_LEVELS - 1 times before it fires. Not thread safe, one per thread.
+// Time is counted in ticks of whatever length the owner advances it by.
+class TimerWheel {
+public:
+    explicit TimerWheel(uint64_t now = 0);
+    ~TimerWheel();
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Fires delay ticks from now (at least one), re-arms the node if it was already armed
+    void schedule(TimerNode* node, uint64_t delay);
+    // Runs every timer due up to and including tick now
+    void advance(uint64_t now);
+    uint64_t now() const;
+
+private:
+    void insert(TimerNode* node);
+    void cascade(int level, int slot);
+
+    TimerNode slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; // list heads
+    uint64_t current;
+};
@@ -0,0 +1,130 @@
+#include "trace.hpp"
+
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+atomic<bool> Trace::recording(false);
+
+namespace {
+
+// Written only by its own thread, read by json() and reset by start() once recording has
+// stopped and the ring has settled
+struct TraceRing {
+    TraceEvent* events = nullptr; // allocated on the first span, most threads never record one
+    atomic<uint64_t> head{0};
+    atomic<bool> writing{false}; // its thread is inside record()
+    uint32_t id;
+    string name;
+    atomic<bool> retired{false};
+    ~TraceRing() { delete[] events; }
+};
+
+mutex rings_mutex; // guards rings, taken when a thread records for the first time, on start and by json()
+vector<TraceRing*> rings;
+uint32_t next_thread_id = 0;
+uint64_t trace_start_ns = 0;
+
+struct ThreadTrace {
+    TraceRing* ring;
+    ThreadTrace() : ring(new TraceRing()) {
+        lock_guard<mutex> lock(rings_mutex);
+        ring->id = next_thread_id++;
+        rings.push_back(ring);
+    }
+    // The ring stays until the next start() so what the thread recorded can still be written out
+    ~ThreadTrace() { ring->retired.store(true, memory_order_release); }
+};
+
+TraceRing& thread_trace() {
+    thread_local ThreadTrace local;
+    return *local.ring;
+}
+
+void append_event(string& out, const TraceEvent& event, uint32_t thread) {
+    char line[320];
+    int length = snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                          event.name, event.category, thread,
+                          double(int64_t(event.start_ns - trace_start_ns)) / 1e3, double(event.duration_ns) / 1e3);
+    if (length > 0) out.append(line, size_t(length) < sizeof(line) ? size_t(length) : sizeof(line) - 1);
+    if (event.arg_name) {
+        length = snprintf(line, sizeof(line), ",\"args\":{\"%s\":%lld}", event.arg_name, (long long)event.arg);
+        if (length > 0) out.append(line, size_t(length) < sizeof(line) ? size_t(length) : sizeof(line) - 1);
+    }
+    out += '}';
+}
+
+// Waits out spans that were being written when recording was switched off. record() sets
+// writing before it checks recording and this runs after recording is cleared, so a thread
+// either sees recording off or is waited for. Called with rings_mutex held
+void settle_rings() {
+    for (TraceRing* ring : rings) {
+        while (ring->writing.load(memory_order_acquire)) this_thread::yield();
+    }
+}
+
+}
+
+void Trace::start() {
+    recording.store(false, memory_order_seq_cst);
+    {
+        lock_guard<mutex> lock(rings_mutex);
+        settle_rings();
+        for (size_t i = 0; i < rings.size();) {
+            if (rings[i]->retired.load(memory_order_acquire)) {
+                delete rings[i];
+                rings[i] = rings.back();
+                rings.pop_back();
+            } else {
+                rings[i]->head.store(0, memory_order_relaxed);
+                ++i;
+            }
+        }
+        trace_start_ns = now();
+    }
+    recording.store(true, memory_order_release);
+}
+
+void Trace::stop() {
+    recording.store(false, memory_order_seq_cst);
+    lock_guard<mutex> lock(rings_mutex);
+    settle_rings();
+}
+
+void Trace::setThreadName(const string& name) {
+    TraceRing& ring = thread_trace();
+    lock_guard<mutex> lock(rings_mutex);
+    ring.name = name;
+}
+
+void Trace::record(const char* category, const char* name, uint64_t start_ns, uint64_t duration_ns, const char* arg_name, int64_t arg) {
+    TraceRing& ring = thread_trace();
+    ring.writing.store(true, memory_order_seq_cst);
+    if (recording.load(memory_order_seq_cst)) {
+        if (!ring.events) ring.events = new TraceEvent[TRACE_RING_EVENTS];
+        uint64_t head = ring.head.load(memory_order_relaxed);
+        ring.events[head & (TRACE_RING_EVENTS - 1)] = {category, name, arg_name, arg, start_ns, duration_ns};
+        ring.head.store(head + 1, memory_order_relaxed);
+    }
+    ring.writing.store(false, memory_order_release);
+}
+
+string Trace::json() {
+    string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"poker server\"}}";
+    lock_guard<mutex> lock(rings_mutex);
+    if (recording.load(memory_order_relaxed)) return out + "\n]}\n";
+    settle_rings();
+    for (TraceRing* ring : rings) {
+        const uint64_t head = ring->head.load(memory_order_relaxed);
+        if (head == 0 || !ring->events) continue;
+
+        const string name = ring->name.empty() ? "thread " + to_string(ring->id) : ring->name;
+        out += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + to_string(ring->id) + ",\"args\":{\"name\":\"" + name + "\"}}";
+
+        const uint64_t first = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        for (uint64_t i = first; i < head; ++i) append_event(out, ring->events[i & (TRACE_RING_EVENTS - 1)], ring->id);
+    }
+    out += "\n]}\n";
+    return out;
+}
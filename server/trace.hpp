@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+using namespace std;
+
+// Spans kept per thread while tracing, older ones are overwritten
+#define TRACE_RING_EVENTS (1 << 15)
+
+struct TraceEvent {
+    const char* category;
+    const char* name;
+    const char* arg_name; // nullptr when the span has no argument
+    int64_t arg;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+};
+
+// Records scoped spans into a ring per thread and writes them out as Chrome trace-event
+// JSON (chrome://tracing, Perfetto). Switched on and off at runtime, a span costs one
+// relaxed load while it is off. Names and categories must be string literals.
+class Trace {
+public:
+    // Starts recording, dropping whatever an earlier run left behind
+    static void start();
+    // Returns once no thread is still writing a span
+    static void stop();
+    static bool enabled() { return recording.load(memory_order_relaxed); }
+
+    // Label for the calling thread's track in the trace
+    static void setThreadName(const string& name);
+
+    static uint64_t now() {
+        return uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    static void record(const char* category, const char* name, uint64_t start_ns, uint64_t duration_ns, const char* arg_name, int64_t arg);
+
+    // Everything recorded since start, empty while still recording
+    static string json();
+
+private:
+    static atomic<bool> recording;
+};
+
+class TraceScope {
+public:
+    TraceScope(const char* new_category, const char* new_name, const char* new_arg_name = nullptr, int64_t new_arg = 0)
+        : category(new_category), name(new_name), arg_name(new_arg_name), arg(new_arg)
+        , start(Trace::enabled() ? Trace::now() : 0) {}
+    ~TraceScope() {
+        if (start && Trace::enabled()) Trace::record(category, name, start, Trace::now() - start, arg_name, arg);
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* category;
+    const char* name;
+    const char* arg_name;
+    int64_t arg;
+    uint64_t start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Builds with TRACE_DISABLED defined have no spans at all
+#ifndef TRACE_DISABLED
+#define TRACE_SCOPE(category, name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(category, name)
+#define TRACE_SCOPE_ARG(category, name, arg_name, arg) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(category, name, arg_name, arg)
+#else
+#define TRACE_SCOPE(category, name) do {} while (0)
+#define TRACE_SCOPE_ARG(category, name, arg_name, arg) do {} while (0)
+#endif
@@ -0,0 +1,36 @@
+#include "zobrist.hpp"
+using namespace std;
+
+namespace {
+
+constexpr uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys make_zobrist_keys() {
+    ZobristKeys keys{};
+    uint64_t state = 0x706F6B6572ULL;
+    for (uint64_t& key : keys.board) key = splitmix64(state);
+    for (auto& seat : keys.hole_cards) {
+        for (uint64_t& key : seat) key = splitmix64(state);
+    }
+    for (uint64_t& key : keys.round) key = splitmix64(state);
+    for (auto& seat : keys.stack) {
+        for (uint64_t& key : seat) key = splitmix64(state);
+    }
+    for (uint64_t& key : keys.current_player) key = splitmix64(state);
+    for (auto& ply : keys.action) {
+        for (auto& seat : ply) {
+            for (uint64_t& key : seat) key = splitmix64(state);
+        }
+    }
+    for (uint64_t& key : keys.amount) key = splitmix64(state);
+    return keys;
+}
+
+}
+
+constexpr ZobristKeys zobrist_keys = make_zobrist_keys();
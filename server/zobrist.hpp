@@ -0,0 +1,41 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include "tablestate.hpp"
+using namespace std;
+
+#define ZOBRIST_STACK_BUCKETS 256
+#define ZOBRIST_AMOUNT_BUCKETS 64
+#define ZOBRIST_MAX_PLY 64
+
+// Random keys for the incremental TableState::hash. They are generated at compile
+// time from a fixed seed, so the same state hashes the same in every process.
+struct ZobristKeys {
+    uint64_t board[52];
+    uint64_t hole_cards[MAXPLAYERS][52];
+    uint64_t round[4];
+    uint64_t stack[MAXPLAYERS][ZOBRIST_STACK_BUCKETS];
+    uint64_t current_player[MAXPLAYERS];
+    uint64_t action[ZOBRIST_MAX_PLY][MAXPLAYERS][4]; // [ply][seat][ActionType]
+    uint64_t amount[ZOBRIST_AMOUNT_BUCKETS];
+};
+
+extern const ZobristKeys zobrist_keys;
+
+// Stacks and raise sizes are hashed in big blind buckets
+inline int zobrist_stack_bucket(int stack) {
+    return min(stack / BIGBLIND, ZOBRIST_STACK_BUCKETS - 1);
+}
+inline int zobrist_amount_bucket(int amount) {
+    return min(amount / BIGBLIND, ZOBRIST_AMOUNT_BUCKETS - 1);
+}
+
+// XOR of the keys of every card in set
+inline uint64_t zobrist_cards(const uint64_t (&keys)[52], CardSet set) {
+    uint64_t hash = 0;
+    uint64_t mask = set.mask;
+    for (int index = 0; mask; ++index, mask >>= 1) {
+        if (mask & 1) hash ^= keys[index];
+    }
+    return hash;
+}
@@ -0,0 +1,167 @@
+#include "server.hpp"
+#include "statsserver.hpp"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTimer>
+#include <QVector>
+
+#include <cstdio>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("serverd"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Headless poker server"));
+    parser.addHelpOption();
+    QCommandLineOption portOption({QStringLiteral("p"), QStringLiteral("port")},
+                                  QStringLiteral("Port to listen on."), QStringLiteral("port"), QString::number(SERVER_PORT));
+    QCommandLineOption threadsOption({QStringLiteral("t"), QStringLiteral("io-threads")},
+                                     QStringLiteral("Number of socket threads, 0 for one per core."), QStringLiteral("count"), QStringLiteral("0"));
+    QCommandLineOption logOption({QStringLiteral("l"), QStringLiteral("log-file")},
+                                 QStringLiteral("Append the log to this file instead of stdout."), QStringLiteral("path"));
+    QCommandLineOption levelOption(QStringLiteral("log-level"),
+                                   QStringLiteral("Lowest level to log: debug, info, warn or error."), QStringLiteral("level"), QStringLiteral("info"));
+    QCommandLineOption sampleOption(QStringLiteral("log-sample"),
+                                    QStringLiteral("Keep one in every N debug/info lines of a category (net, protocol, server, engine, game)."),
+                                    QStringLiteral("category=N"));
+    QCommandLineOption tablesOption(QStringLiteral("tables"),
+                                    QStringLiteral("Number of tables to host."), QStringLiteral("count"), QStringLiteral("1"));
+    QCommandLineOption statsPortOption(QStringLiteral("stats-port"),
+                                       QStringLiteral("Serve Prometheus metrics on this local port, 0 for none."), QStringLiteral("port"), QStringLiteral("0"));
+    QCommandLineOption statsIntervalOption(QStringLiteral("stats-interval"),
+                                           QStringLiteral("Log a latency summary every this many seconds, 0 for never."), QStringLiteral("seconds"), QStringLiteral("0"));
+    QCommandLineOption traceOption(QStringLiteral("trace"),
+                                   QStringLiteral("Record a Chrome trace for the whole run and write it here on exit."), QStringLiteral("path"));
+    QCommandLineOption localOption(QStringLiteral("local"),
+                                   QStringLiteral("Also let bots on this host connect through shared memory, at this socket path."),
+                                   QStringLiteral("path"));
+    QCommandLineOption houseBotOption(QStringLiteral("house-bot"),
+                                      QStringLiteral("Seat bots from this bot library at the first free seats, count of them (1 if left out). Can be repeated."),
+                                      QStringLiteral("library[=count]"));
+    QCommandLineOption houseBotConfigOption(QStringLiteral("house-bot-config"),
+                                            QStringLiteral("String passed to every house bot as it is created."), QStringLiteral("config"));
+    QCommandLineOption botBudgetOption(QStringLiteral("bot-budget-ms"),
+                                       QStringLiteral("Time each house bot decision may take."), QStringLiteral("ms"),
+                                       QString::number(HOUSE_BOT_BUDGET_MS));
+    parser.addOption(portOption);
+    parser.addOption(localOption);
+    parser.addOption(tablesOption);
+    parser.addOption(threadsOption);
+    parser.addOption(logOption);
+    parser.addOption(levelOption);
+    parser.addOption(sampleOption);
+    parser.addOption(statsPortOption);
+    parser.addOption(statsIntervalOption);
+    parser.addOption(traceOption);
+    parser.addOption(houseBotOption);
+    parser.addOption(houseBotConfigOption);
+    parser.addOption(botBudgetOption);
+    parser.process(a);
+
+    bool ok = false;
+    const quint16 port = parser.value(portOption).toUShort(&ok);
+    if (!ok) parser.showHelp(1);
+    const int ioThreads = parser.value(threadsOption).toInt(&ok);
+    if (!ok || ioThreads < 0) parser.showHelp(1);
+    const int numTables = parser.value(tablesOption).toInt(&ok);
+    if (!ok || numTables < 1) parser.showHelp(1);
+    const quint16 statsPort = parser.value(statsPortOption).toUShort(&ok);
+    if (!ok) parser.showHelp(1);
+    const int statsInterval = parser.value(statsIntervalOption).toInt(&ok);
+    if (!ok || statsInterval < 0) parser.showHelp(1);
+    const int botBudget = parser.value(botBudgetOption).toInt(&ok);
+    if (!ok || botBudget < 1) parser.showHelp(1);
+    QVector<QPair<QString, int>> houseBots;
+    for (const QString &houseBot : parser.values(houseBotOption)) {
+        const int split = houseBot.lastIndexOf(QLatin1Char('='));
+        int count = 1;
+        if (split >= 0) {
+            count = houseBot.mid(split + 1).toInt(&ok);
+            if (!ok || count < 1) parser.showHelp(1);
+        }
+        houseBots.append({split >= 0 ? houseBot.left(split) : houseBot, count});
+    }
+
+    const QStringList levels = {QStringLiteral("debug"), QStringLiteral("info"), QStringLiteral("warn"), QStringLiteral("error")};
+    const int level = levels.indexOf(parser.value(levelOption).toLower());
+    if (level < 0) parser.showHelp(1);
+    Logger::setLevel(level);
+
+    const QStringList categories = {QStringLiteral("net"), QStringLiteral("protocol"), QStringLiteral("server"), QStringLiteral("engine"), QStringLiteral("game")};
+    for (const QString &sample : parser.values(sampleOption)) {
+        const int category = categories.indexOf(sample.section(QLatin1Char('='), 0, 0));
+        const uint rate = sample.section(QLatin1Char('='), 1).toUInt(&ok);
+        if (category < 0 || !ok) parser.showHelp(1);
+        Logger::setSampleRate(LogCategory(category), rate);
+    }
+
+    FILE *logFile = stdout;
+    if (parser.isSet(logOption)) {
+        logFile = fopen(QFile::encodeName(parser.value(logOption)).constData(), "a");
+        if (!logFile) {
+            fprintf(stderr, "Unable to open log file %s\n", qPrintable(parser.value(logOption)));
+            return 1;
+        }
+    }
+    Logger::start(logFile);
+    if (parser.isSet(traceOption)) Trace::start();
+
+    int result = 1;
+    {
+        // The main thread has nothing else to do, so it doubles as the table thread
+        Server server(nullptr, ioThreads, numTables);
+        server.setHouseBotBudget(botBudget);
+        for (const QPair<QString, int> &houseBot : houseBots) {
+            QString error;
+            for (int i = 0; i < houseBot.second; ++i) {
+                if (server.seatHouseBot(houseBot.first, parser.value(houseBotConfigOption), &error)) continue;
+                LOG_ERROR(LOG_SERVER, "Unable to seat a house bot from %s: %s", qPrintable(houseBot.first), qPrintable(error));
+                break;
+            }
+        }
+        StatsServer stats;
+        QTimer statsTimer;
+        if (statsPort) {
+            if (stats.startServer(statsPort)) LOG_INFO(LOG_SERVER, "Metrics on http://127.0.0.1:%u/metrics", unsigned(statsPort));
+            else LOG_ERROR(LOG_SERVER, "Unable to serve metrics on port %u: %s", unsigned(statsPort), qPrintable(stats.errorString()));
+        }
+        if (statsInterval) {
+            // One line per record, a whole summary does not fit in one
+            QObject::connect(&statsTimer, &QTimer::timeout, []() {
+                const QStringList lines = QString::fromStdString(Metrics::summary()).split(QLatin1Char('\n'), Qt::SkipEmptyParts);
+                for (const QString &line : lines) LOG_INFO(LOG_SERVER, "stats %s", qPrintable(line));
+            });
+            statsTimer.start(statsInterval * 1000);
+        }
+        if (parser.isSet(localOption)) {
+            const QString localPath = parser.value(localOption);
+            if (server.startLocalServer(localPath)) LOG_INFO(LOG_SERVER, "Local connections on %s", qPrintable(localPath));
+            else LOG_ERROR(LOG_SERVER, "Unable to listen on %s: %s", qPrintable(localPath), qPrintable(server.localErrorString()));
+        }
+        if (server.startServer(port)) {
+            LOG_INFO(LOG_SERVER, "Server started on port %u", unsigned(port));
+            result = a.exec();
+        } else {
+            LOG_ERROR(LOG_SERVER, "Unable to listen on port %u: %s", unsigned(port), qPrintable(server.errorString()));
+        }
+    }
+
+    if (parser.isSet(traceOption)) {
+        // Only the spans still in each thread's ring are kept, the most recent ones
+        Trace::stop();
+        QFile traceFile(parser.value(traceOption));
+        if (traceFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            traceFile.write(QByteArray::fromStdString(Trace::json()));
+        } else {
+            LOG_ERROR(LOG_SERVER, "Unable to write trace to %s", qPrintable(parser.value(traceOption)));
+        }
+    }
+
+    Logger::stop();
+    if (logFile != stdout) fclose(logFile);
+    return result;
+}
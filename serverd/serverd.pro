@@ -0,0 +1,68 @@
+QT       += core network
+QT       -= gui
+
+TARGET = serverd
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Headless build of the server: the same game and networking code as server/, without the window
+
+SERVER_DIR = ../server
+
+INCLUDEPATH += $$SERVER_DIR ../shared
+
+SOURCES += \
+    main.cpp \
+    $$SERVER_DIR/cards.cpp \
+    $$SERVER_DIR/engine.cpp \
+    $$SERVER_DIR/evaluate.cpp \
+    $$SERVER_DIR/game.cpp \
+    $$SERVER_DIR/housebots.cpp \
+    $$SERVER_DIR/ioshard.cpp \
+    $$SERVER_DIR/logger.cpp \
+    $$SERVER_DIR/metrics.cpp \
+    $$SERVER_DIR/player.cpp \
+    $$SERVER_DIR/publicstate.cpp \
+    $$SERVER_DIR/pots.cpp \
+    $$SERVER_DIR/server.cpp \
+    $$SERVER_DIR/serverworker.cpp \
+    $$SERVER_DIR/statsserver.cpp \
+    $$SERVER_DIR/tablestate.cpp \
+    $$SERVER_DIR/timerwheel.cpp \
+    $$SERVER_DIR/trace.cpp \
+    $$SERVER_DIR/zobrist.cpp \
+    ../shared/wireprotocol.cpp \
+    ../shared/messages.cpp \
+    ../shared/shmchannel.cpp
+
+HEADERS += \
+    $$SERVER_DIR/botapi.hpp \
+    $$SERVER_DIR/cards.hpp \
+    $$SERVER_DIR/engine.hpp \
+    $$SERVER_DIR/evaluate.hpp \
+    $$SERVER_DIR/game.hpp \
+    $$SERVER_DIR/housebots.hpp \
+    $$SERVER_DIR/ioshard.hpp \
+    $$SERVER_DIR/logger.hpp \
+    $$SERVER_DIR/metrics.hpp \
+    $$SERVER_DIR/player.hpp \
+    $$SERVER_DIR/publicstate.hpp \
+    $$SERVER_DIR/pots.hpp \
+    $$SERVER_DIR/server.hpp \
+    $$SERVER_DIR/serverworker.hpp \
+    $$SERVER_DIR/session.hpp \
+    $$SERVER_DIR/statsserver.hpp \
+    $$SERVER_DIR/tablestate.hpp \
+    $$SERVER_DIR/timerwheel.hpp \
+    $$SERVER_DIR/trace.hpp \
+    $$SERVER_DIR/zobrist.hpp \
+    ../shared/wireprotocol.hpp \
+    ../shared/messages.hpp \
+    ../shared/messageschema.hpp \
+    ../shared/shmchannel.hpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,77 @@
+#include "messages.hpp"
+
+namespace MessageField {
+
+Cards::Type Cards::fromJson(const QJsonValue &value) {
+    const QJsonArray cards = value.toArray();
+    QStringList list;
+    list.reserve(cards.size());
+    for (const QJsonValue &cardVal : cards) list.append(cardVal.toString());
+    return list;
+}
+
+Players::Type Players::fromJson(const QJsonValue &value) {
+    Type players;
+    for (const QJsonValue &playerVal : value.toArray()) {
+        const QJsonObject playerObj = playerVal.toObject();
+        PlayerSeat seat;
+        seat.player_id = playerObj.value(QLatin1String("player_id")).toInt(-1);
+        seat.username = playerObj.value(QLatin1String("username")).toString();
+        seat.stack = playerObj.value(QLatin1String("stack")).toInt();
+        seat.role = playerObj.value(QLatin1String("role")).toString();
+        players.append(seat);
+    }
+    return players;
+}
+
+void Players::toJson(QJsonObject &payload, QLatin1String name, const Type &value) {
+    QJsonArray players;
+    for (const PlayerSeat &seat : value) {
+        QJsonObject playerObj;
+        playerObj[QLatin1String("player_id")] = seat.player_id;
+        playerObj[QLatin1String("username")] = seat.username;
+        playerObj[QLatin1String("stack")] = seat.stack;
+        playerObj[QLatin1String("role")] = seat.role;
+        players.append(playerObj);
+    }
+    payload[name] = players;
+}
+
+Winners::Type Winners::fromJson(const QJsonValue &value) {
+    Type winners;
+    for (const QJsonValue &winnerVal : value.toArray()) {
+        if (!winnerVal.isObject()) continue;
+        const QJsonObject winnerObj = winnerVal.toObject();
+        winners.append({winnerObj.value(QLatin1String("winner_id")).toInt(-1), winnerObj.value(QLatin1String("payout")).toInt()});
+    }
+    return winners;
+}
+
+void Winners::toJson(QJsonObject &payload, QLatin1String name, const Type &value) {
+    QJsonArray winners;
+    for (const pair<int, int> &winner : value) {
+        QJsonObject winnerObj;
+        winnerObj[QLatin1String("winner_id")] = winner.first;
+        winnerObj[QLatin1String("payout")] = winner.second;
+        winners.append(winnerObj);
+    }
+    payload[name] = winners;
+}
+
+}
+
+#define FIELD_FROM_JSON(kind, name) decoded.name = MessageField::kind::fromJson(payload.value(QLatin1String(#name)));
+#define FIELD_TO_JSON(kind, name) MessageField::kind::toJson(payload, QLatin1String(#name), name);
+#define MESSAGE_CODEC(ID, TYPE, NAME, ENCODING)                        \
+    NAME##Message NAME##Message::fromJson(const QJsonObject &payload) { \
+        Q_UNUSED(payload);                                             \
+        NAME##Message decoded;                                         \
+        ID##_FIELDS(FIELD_FROM_JSON)                                   \
+        return decoded;                                                \
+    }                                                                  \
+    QJsonObject NAME##Message::toJson() const {                        \
+        QJsonObject payload;                                           \
+        ID##_FIELDS(FIELD_TO_JSON)                                     \
+        return payload;                                                \
+    }
+WIRE_MESSAGES(MESSAGE_CODEC)
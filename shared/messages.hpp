@@ -0,0 +1,177 @@
+#pragma once
+
+#include <optional>
+#include <utility>
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QList>
+#include <QMetaType>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "wireprotocol.hpp"
+using namespace std;
+
+// Typed messages generated from messageschema.hpp: PLAYER_ACTION is a PlayerActionMessage
+// with one member per payload field. WireProtocol::encode and decode go between these and
+// frames directly, fromJson() and toMessage() are their JSON form. Missing fields are left
+// at the kind's default, so a message always reads the same whatever sent it.
+
+// A seat as GAME_STATE and STATE_DELTA describe it
+struct PlayerSeat {
+    int player_id = -1;
+    QString username;
+    int stack = 0;
+    QString role; // "D", "SB", "BB" or "None"
+
+    bool operator==(const PlayerSeat &other) const {
+        return player_id == other.player_id && stack == other.stack && username == other.username && role == other.role;
+    }
+    bool operator!=(const PlayerSeat &other) const { return !(*this == other); }
+};
+
+// How each kind of field is held and written to JSON. The binary side of each kind is
+// in wireprotocol.cpp
+namespace MessageField {
+
+// Ints that read as Default when missing. Each kind is its own type so that its binary
+// form is picked by overloading on it
+template <int Default>
+struct IntField {
+    typedef int Type;
+    static Type initial() { return Default; }
+    static Type fromJson(const QJsonValue &value) { return value.toInt(Default); }
+    static void toJson(QJsonObject &payload, QLatin1String name, Type value) { payload[name] = value; }
+};
+
+struct Byte : IntField<0> {};
+struct Id : IntField<-1> {};
+struct Amount : IntField<0> {};
+struct TableId : IntField<-1> {};
+
+struct Varint {
+    typedef quint32 Type;
+    static Type initial() { return 0; }
+    static Type fromJson(const QJsonValue &value) { return quint32(value.toDouble()); }
+    static void toJson(QJsonObject &payload, QLatin1String name, Type value) { payload[name] = qint64(value); }
+};
+
+struct Seq : Varint {
+    static void toJson(QJsonObject &payload, QLatin1String name, Type value) {
+        if (value) payload[name] = qint64(value);
+    }
+};
+
+struct String {
+    typedef QString Type;
+    static Type initial() { return QString(); }
+    static Type fromJson(const QJsonValue &value) { return value.toString(); }
+    static void toJson(QJsonObject &payload, QLatin1String name, const Type &value) { payload[name] = value; }
+};
+
+struct Action {
+    typedef WireProtocol::Action Type;
+    static Type initial() { return WireProtocol::NO_ACTION; }
+    static Type fromJson(const QJsonValue &value) { return WireProtocol::action(value.toString()); }
+    static void toJson(QJsonObject &payload, QLatin1String name, Type value) { payload[name] = WireProtocol::actionName(value); }
+};
+
+struct Round {
+    typedef WireProtocol::Round Type;
+    static Type initial() { return WireProtocol::NO_ROUND; }
+    static Type fromJson(const QJsonValue &value) { return WireProtocol::round(value.toString()); }
+    static void toJson(QJsonObject &payload, QLatin1String name, Type value) { payload[name] = WireProtocol::roundName(value); }
+};
+
+struct Cards {
+    typedef QStringList Type;
+    static Type initial() { return QStringList(); }
+    static Type fromJson(const QJsonValue &value);
+    static void toJson(QJsonObject &payload, QLatin1String name, const Type &value) { payload[name] = QJsonArray::fromStringList(value); }
+};
+
+struct Players {
+    typedef QVector<PlayerSeat> Type;
+    static Type initial() { return Type(); }
+    static Type fromJson(const QJsonValue &value);
+    static void toJson(QJsonObject &payload, QLatin1String name, const Type &value);
+};
+
+struct Winners {
+    typedef QList<pair<int, int>> Type; // winner_id, payout
+    static Type initial() { return Type(); }
+    static Type fromJson(const QJsonValue &value);
+    static void toJson(QJsonObject &payload, QLatin1String name, const Type &value);
+};
+
+struct Flag {
+    typedef bool Type;
+    static Type initial() { return false; }
+    static Type fromJson(const QJsonValue &value) { return value.toBool(); }
+    static void toJson(QJsonObject &payload, QLatin1String name, Type value) {
+        if (value) payload[name] = true;
+    }
+};
+
+struct MaybeAmount {
+    typedef optional<int> Type;
+    static Type initial() { return nullopt; }
+    static Type fromJson(const QJsonValue &value) { return value.isUndefined() ? Type() : Type(value.toInt()); }
+    static void toJson(QJsonObject &payload, QLatin1String name, const Type &value) {
+        if (value) payload[name] = *value;
+    }
+};
+
+struct MaybeId : MaybeAmount {
+    static Type fromJson(const QJsonValue &value) { return value.isUndefined() ? Type() : Type(value.toInt(-1)); }
+};
+
+}
+
+#define MESSAGE_MEMBER(kind, name) MessageField::kind::Type name = MessageField::kind::initial();
+#define MESSAGE_STRUCT(ID, TYPE, NAME, ENCODING)                       \
+    struct NAME##Message {                                             \
+        static constexpr WireProtocol::MessageId id = WireProtocol::ID; \
+        ID##_FIELDS(MESSAGE_MEMBER)                                    \
+        static NAME##Message fromJson(const QJsonObject &payload);     \
+        QJsonObject toJson() const;                                    \
+        QJsonObject toMessage() const { return WireProtocol::message(id, toJson()); } \
+    };
+WIRE_MESSAGES(MESSAGE_STRUCT)
+#undef MESSAGE_STRUCT
+#undef MESSAGE_MEMBER
+
+// Decoded on the I/O threads and handed to the table thread
+Q_DECLARE_METATYPE(AnyMessage)
+
+// Handlers indexed by message id, so dispatch is one array lookup. Each handler is a member
+// of Receiver that takes Args and the typed message:
+//     MessageDispatch<Server, ServerWorker*> handlers;
+//     handlers.on<JoinGameRequestMessage, &Server::joinTable>(); // joinTable(ServerWorker*, const JoinGameRequestMessage&)
+//     handlers.dispatch(this, sender, message);
+template <class Receiver, class... Args>
+class MessageDispatch
+{
+public:
+    template <class Message, void (Receiver::*handler)(Args..., const Message&)>
+    void on() {
+        handlers[Message::id] = [](Receiver *receiver, Args... args, const AnyMessage &message) {
+            (receiver->*handler)(args..., get<Message>(message));
+        };
+    }
+
+    // False when nothing handles the message, it is then ignored
+    bool dispatch(Receiver *receiver, Args... args, const AnyMessage &message) const {
+        const size_t id = message.index();
+        if (id >= WireProtocol::NUM_MESSAGE_IDS || !handlers[id]) return false;
+        handlers[id](receiver, args..., message);
+        return true;
+    }
+
+private:
+    typedef void (*Handler)(Receiver*, Args..., const AnyMessage&);
+    Handler handlers[WireProtocol::NUM_MESSAGE_IDS] = {};
+};
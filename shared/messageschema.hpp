@@ -0,0 +1,142 @@
+#pragma once
+
+// The messages in json_message_formats.txt, from which WireProtocol::MessageId, the
+// binary encoding and the typed messages in messages.hpp are generated.
+//
+// X(id, type, name, encoding): id is the WireProtocol::MessageId and is also the id byte
+// of a binary frame, so new messages only ever go at the end. name gives the typed
+// message nameMessage. The encoding is BINARY when the binary form is generated from
+// the fields below, CUSTOM when it is written by hand in wireprotocol.cpp, and JSON for
+// messages that are always sent as JSON.
+#define WIRE_MESSAGES(X) \
+    X(HELLO,             "HELLO",             Hello,            BINARY) \
+    X(JOIN_GAME_REQUEST, "JOIN_GAME_REQUEST", JoinGameRequest,  BINARY) \
+    X(JOIN_GAME_ACCEPT,  "JOIN_GAME_ACCEPT",  JoinGameAccept,   BINARY) \
+    X(PLAYER_ACTION,     "PLAYER_ACTION",     PlayerAction,     BINARY) \
+    X(REQUEST_STATE,     "REQUEST_STATE",     RequestState,     BINARY) \
+    X(ACTION_LOG,        "ACTION_LOG",        ActionLog,        BINARY) \
+    X(GAME_STATE,        "GAME_STATE",        GameState,        BINARY) \
+    X(PLAYER_JOINED,     "PLAYER_JOINED",     PlayerJoined,     BINARY) \
+    X(PLAYER_LEFT,       "PLAYER_LEFT",       PlayerLeft,       BINARY) \
+    X(DEAL_HOLE_CARDS,   "DEAL_HOLE_CARDS",   DealHoleCards,    BINARY) \
+    X(DEAL_COMMUNITY,    "DEAL_COMMUNITY",    DealCommunity,    BINARY) \
+    X(ROUND_END,         "ROUND_END",         RoundEnd,         BINARY) \
+    X(REVEAL_CARDS,      "REVEAL_CARDS",      RevealCards,      BINARY) \
+    X(ERROR_MESSAGE,     "ERROR",             Error,            BINARY) \
+    X(STATE_DELTA,       "STATE_DELTA",       StateDelta,       CUSTOM) \
+    X(RESUME_SESSION,    "RESUME_SESSION",    ResumeSession,    JSON)   \
+    X(RESUME_ACCEPT,     "RESUME_ACCEPT",     ResumeAccept,     JSON)   \
+    X(RESUME_REJECT,     "RESUME_REJECT",     ResumeReject,     JSON)   \
+    X(WATCH_TABLE,       "WATCH_TABLE",       WatchTable,       JSON)   \
+    X(UNWATCH_TABLE,     "UNWATCH_TABLE",     UnwatchTable,     JSON)   \
+    X(ACTION_CLOCK,      "ACTION_CLOCK",      ActionClock,      BINARY)
+
+// Payload of each message, F(kind, name) in binary order. The kinds are in messages.hpp:
+//   Byte     int, one byte
+//   Id       int, one byte, -1 when missing
+//   Amount   int, zigzag varint
+//   TableId  int, zigzag varint, -1 when missing
+//   Varint   quint32
+//   Seq      quint32 varint, left out of the JSON when 0
+//   String   QString, varint length then UTF-8
+//   Action   WireProtocol::Action, one byte
+//   Round    WireProtocol::Round, one byte
+//   Cards    QStringList, a count then one byte per card
+//   Players  QVector<PlayerSeat>, a count then each seat's id, username, stack and role
+//   Winners  QList<pair<winner_id, payout>>
+//   Flag     bool, one byte, left out of the JSON when false
+//   MaybeAmount, MaybeId  optional<int>, left out of the JSON when empty
+#define HELLO_FIELDS(F) \
+    F(Byte, binary_version)
+
+#define JOIN_GAME_REQUEST_FIELDS(F) \
+    F(String, username) \
+    F(TableId, table_id)
+
+#define JOIN_GAME_ACCEPT_FIELDS(F) \
+    F(Id, player_id) \
+    F(String, username) \
+    F(TableId, table_id) \
+    F(String, resume_token) \
+    F(Seq, seq)
+
+#define PLAYER_ACTION_FIELDS(F) \
+    F(Seq, seq) \
+    F(Id, player_id) \
+    F(String, username) \
+    F(Action, action) \
+    F(Amount, to_call) \
+    F(Amount, raise_amt) \
+    F(Amount, amount) \
+    F(Flag, timed_out)
+
+#define REQUEST_STATE_FIELDS(F)
+
+#define ACTION_LOG_FIELDS(F) \
+    F(String, message)
+
+#define GAME_STATE_FIELDS(F) \
+    F(Varint, version) \
+    F(Players, players) \
+    F(Amount, game_no) \
+    F(Amount, pot) \
+    F(Cards, board) \
+    F(Id, current_player) \
+    F(Amount, to_call)
+
+// Only what changed, the binary form flags which fields follow
+#define STATE_DELTA_FIELDS(F) \
+    F(Varint, version) \
+    F(Players, players) \
+    F(MaybeAmount, game_no) \
+    F(MaybeAmount, pot) \
+    F(MaybeId, current_player) \
+    F(MaybeAmount, to_call) \
+    F(Cards, board_new) \
+    F(Flag, board_reset)
+
+#define PLAYER_JOINED_FIELDS(F) \
+    F(Seq, seq) \
+    F(Id, player_id) \
+    F(String, username)
+
+#define PLAYER_LEFT_FIELDS(F) PLAYER_JOINED_FIELDS(F)
+
+#define DEAL_HOLE_CARDS_FIELDS(F) \
+    F(Cards, cards)
+
+#define DEAL_COMMUNITY_FIELDS(F) \
+    F(Round, round) \
+    F(Cards, board)
+
+#define ROUND_END_FIELDS(F) \
+    F(Winners, winners)
+
+#define REVEAL_CARDS_FIELDS(F) \
+    F(Seq, seq) \
+    F(Id, player_id) \
+    F(Cards, cards)
+
+#define ERROR_MESSAGE_FIELDS(F) ACTION_LOG_FIELDS(F)
+
+#define RESUME_SESSION_FIELDS(F) \
+    F(String, resume_token) \
+    F(Seq, seq)
+
+#define RESUME_ACCEPT_FIELDS(F) JOIN_GAME_ACCEPT_FIELDS(F)
+
+#define RESUME_REJECT_FIELDS(F) ACTION_LOG_FIELDS(F)
+
+#define WATCH_TABLE_FIELDS(F) \
+    F(TableId, table_id)
+
+#define UNWATCH_TABLE_FIELDS(F)
+
+#define ACTION_CLOCK_FIELDS(F) \
+    F(Id, player_id) \
+    F(Amount, remaining_ms) \
+    F(Flag, time_bank)
+
+// Enum fields, sent as their index here
+#define WIRE_ACTIONS(X) X(FOLD) X(CALL) X(RAISE) X(CHECK)
+#define WIRE_ROUNDS(X) X(PREFLOP) X(FLOP) X(TURN) X(RIVER)
@@ -0,0 +1,344 @@
+#include "shmchannel.hpp"
+
+#include <QtEndian>
+
+#if defined(Q_OS_LINUX)
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// The control block gets its own pages ahead of the rings, enough for any page size in use
+#define SHM_CONTROL_BYTES (64 * 1024)
+#define SHM_TOTAL_BYTES (SHM_CONTROL_BYTES + 2 * SHM_RING_BYTES)
+#define SHM_MAGIC 0x706b7231 // "pkr1"
+
+static_assert((SHM_RING_BYTES & (SHM_RING_BYTES - 1)) == 0, "positions are masked with the ring size");
+static_assert(SHM_RING_BYTES % SHM_CONTROL_BYTES == 0, "rings have to start on a page boundary");
+
+ShmChannel::ShmChannel(QObject *parent) : QObject(parent) {}
+
+ShmChannel::~ShmChannel() {
+    // Nobody is left to hear about it
+    blockSignals(true);
+    close();
+}
+
+bool ShmChannel::isOpen() const {
+    return socketFd >= 0;
+}
+
+bool ShmChannel::isConnected() const {
+    return open;
+}
+
+bool ShmChannel::accept(qintptr socketDescriptor) {
+
+    close();
+    socketFd = int(socketDescriptor);
+
+    const int memfd = memfd_create("poker-engine", MFD_CLOEXEC);
+    if (memfd < 0 || ftruncate(memfd, SHM_TOTAL_BYTES) < 0 || !map(memfd, true)) {
+        if (memfd >= 0) ::close(memfd);
+        close();
+        return false;
+    }
+    new (control) Control();
+    control->magic = SHM_MAGIC;
+    control->ringBytes = SHM_RING_BYTES;
+    // Both sides start out asleep, so the first frame either way wakes its reader
+    in->readerWaiting.store(1, memory_order_relaxed);
+    out->readerWaiting.store(1, memory_order_relaxed);
+
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    peerFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    // The memory and both eventfds go over in one message, the client's own eventfd first
+    bool sent = false;
+    if (wakeFd >= 0 && peerFd >= 0) {
+        const int fds[3] = {memfd, peerFd, wakeFd};
+        char byte = 0;
+        iovec iov = {&byte, 1};
+        alignas(cmsghdr) char buffer[CMSG_SPACE(sizeof(fds))] = {};
+        msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = buffer;
+        msg.msg_controllen = sizeof(buffer);
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+        sent = sendmsg(socketFd, &msg, MSG_NOSIGNAL) == 1;
+    }
+    ::close(memfd);
+    if (!sent) {
+        close();
+        return false;
+    }
+
+    socketNotifier = new QSocketNotifier(socketFd, QSocketNotifier::Read, this);
+    connect(socketNotifier, &QSocketNotifier::activated, this, &ShmChannel::socketActivity);
+    wakeNotifier = new QSocketNotifier(wakeFd, QSocketNotifier::Read, this);
+    connect(wakeNotifier, &QSocketNotifier::activated, this, &ShmChannel::eventActivity);
+    open = true;
+    return true;
+}
+
+bool ShmChannel::connectTo(const QString &path) {
+
+    close();
+    const QByteArray encoded = path.toLocal8Bit();
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (encoded.size() >= int(sizeof(address.sun_path))) return false;
+    memcpy(address.sun_path, encoded.constData(), size_t(encoded.size()));
+
+    socketFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socketFd < 0) return false;
+    if (::connect(socketFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        ::close(socketFd);
+        socketFd = -1;
+        return false;
+    }
+
+    // The rings arrive on the socket once the server gets round to accepting us
+    socketNotifier = new QSocketNotifier(socketFd, QSocketNotifier::Read, this);
+    connect(socketNotifier, &QSocketNotifier::activated, this, &ShmChannel::socketActivity);
+    return true;
+}
+
+void ShmChannel::close() {
+
+    if (socketFd < 0) return;
+    const bool wasOpen = open;
+
+    // Called from the notifiers' own slots, so they are only deleted later
+    for (QSocketNotifier *notifier : {socketNotifier, wakeNotifier}) {
+        if (!notifier) continue;
+        notifier->setEnabled(false);
+        notifier->deleteLater();
+    }
+    socketNotifier = nullptr;
+    wakeNotifier = nullptr;
+    for (int *fd : {&socketFd, &wakeFd, &peerFd}) {
+        if (*fd >= 0) ::close(*fd);
+        *fd = -1;
+    }
+    unmap();
+    open = false;
+    blocked = false;
+
+    if (wasOpen) emit disconnected();
+}
+
+bool ShmChannel::map(int memfd, bool server) {
+
+    void *controlPages = mmap(nullptr, SHM_CONTROL_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (controlPages == MAP_FAILED) return false;
+    control = static_cast<Control*>(controlPages);
+
+    char *data[2];
+    for (int i = 0; i < 2; ++i) {
+        // Reserve twice the ring, then put the same pages in both halves
+        void *base = mmap(nullptr, 2 * SHM_RING_BYTES, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            data[i] = nullptr;
+        } else {
+            data[i] = static_cast<char*>(base);
+            const off_t offset = SHM_CONTROL_BYTES + off_t(i) * SHM_RING_BYTES;
+            for (char *half : {data[i], data[i] + SHM_RING_BYTES}) {
+                if (mmap(half, SHM_RING_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memfd, offset) == MAP_FAILED) {
+                    munmap(base, 2 * SHM_RING_BYTES);
+                    data[i] = nullptr;
+                    break;
+                }
+            }
+        }
+    }
+    const int inRing = server ? 0 : 1;
+    in = &control->rings[inRing];
+    out = &control->rings[1 - inRing];
+    inData = data[inRing];
+    outData = data[1 - inRing];
+    if (!inData || !outData) {
+        unmap();
+        return false;
+    }
+    return true;
+}
+
+void ShmChannel::unmap() {
+    if (inData) munmap(inData, 2 * SHM_RING_BYTES);
+    if (outData) munmap(outData, 2 * SHM_RING_BYTES);
+    if (control) munmap(control, SHM_CONTROL_BYTES);
+    control = nullptr;
+    in = out = nullptr;
+    inData = outData = nullptr;
+    readPos = writePos = 0;
+    frameSize = -1;
+}
+
+void ShmChannel::socketActivity() {
+
+    if (open) {
+        // Nothing is sent after the handshake, so this is the peer going away
+        char byte;
+        const ssize_t received = recv(socketFd, &byte, 1, 0);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) close();
+        return;
+    }
+
+    int fds[3] = {-1, -1, -1};
+    char byte;
+    iovec iov = {&byte, 1};
+    alignas(cmsghdr) char buffer[CMSG_SPACE(sizeof(fds))] = {};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = buffer;
+    msg.msg_controllen = sizeof(buffer);
+    const ssize_t received = recvmsg(socketFd, &msg, MSG_CMSG_CLOEXEC);
+    if (received < 0 && (errno == EAGAIN || errno == EINTR)) return;
+
+    const cmsghdr *cmsg = received == 1 ? CMSG_FIRSTHDR(&msg) : nullptr;
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(fds))) {
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    }
+    wakeFd = fds[1];
+    peerFd = fds[2];
+
+    struct stat info;
+    const bool mapped = fds[0] >= 0 && fstat(fds[0], &info) == 0 && info.st_size >= SHM_TOTAL_BYTES && map(fds[0], false);
+    if (fds[0] >= 0) ::close(fds[0]);
+    if (!mapped || wakeFd < 0 || peerFd < 0 || control->magic != SHM_MAGIC || control->ringBytes != SHM_RING_BYTES) {
+        // Not a server we can talk to, report it as a failed connection
+        open = true;
+        close();
+        return;
+    }
+
+    wakeNotifier = new QSocketNotifier(wakeFd, QSocketNotifier::Read, this);
+    connect(wakeNotifier, &QSocketNotifier::activated, this, &ShmChannel::eventActivity);
+    open = true;
+    emit connected();
+}
+
+void ShmChannel::eventActivity() {
+    quint64 count;
+    if (read(wakeFd, &count, sizeof(count)) < 0 && errno != EAGAIN) return;
+    if (blocked) {
+        blocked = false;
+        emit writable();
+    }
+    if (open) emit readyRead();
+}
+
+void ShmChannel::wake() {
+    const quint64 one = 1;
+    if (write(peerFd, &one, sizeof(one)) < 0 && errno != EAGAIN) close();
+}
+
+bool ShmChannel::writeFrame(const QByteArray &frame) {
+
+    if (!open || frame.size() > SHM_RING_BYTES) return false;
+    const quint32 size = quint32(frame.size());
+    // The peer can write anything to tail, a position that makes no sense reads as a full ring
+    auto room = [this]() {
+        const quint32 used = writePos - out->tail.load(memory_order_acquire);
+        return used > SHM_RING_BYTES ? 0 : SHM_RING_BYTES - used;
+    };
+    if (room() < size) {
+        // Ask the reader to wake us, then look again in case it read in the meantime
+        out->writerWaiting.store(1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (room() < size) {
+            blocked = true;
+            return false;
+        }
+        out->writerWaiting.store(0, memory_order_relaxed);
+    }
+
+    memcpy(outData + (writePos & (SHM_RING_BYTES - 1)), frame.constData(), size);
+    writePos += size;
+    out->head.store(writePos, memory_order_release);
+    return true;
+}
+
+void ShmChannel::flush() {
+    if (!open) return;
+    atomic_thread_fence(memory_order_seq_cst);
+    if (out->readerWaiting.load(memory_order_relaxed) && out->readerWaiting.exchange(0)) wake();
+}
+
+bool ShmChannel::hasFrame() {
+
+    if (!open) return false;
+    if (frameSize >= 0) return true;
+    quint32 head = in->head.load(memory_order_acquire);
+    if (head == readPos) {
+        // Going to sleep, the writer wakes us if it writes after this
+        in->readerWaiting.store(1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        head = in->head.load(memory_order_acquire);
+        if (head == readPos) return false;
+        in->readerWaiting.store(0, memory_order_relaxed);
+    }
+
+    // The peer only ever publishes whole frames, anything else means it cannot be trusted.
+    // The length is kept rather than read again, the peer could change it under us
+    const quint32 available = head - readPos;
+    const quint32 length = available < 4 ? 0 : qFromBigEndian<quint32>(inData + (readPos & (SHM_RING_BYTES - 1)));
+    const qint64 size = length == 0xFFFFFFFF ? 0 : qint64(length); // QDataStream's null QByteArray
+    if (available < 4 || available > SHM_RING_BYTES || size + 4 > available) {
+        close();
+        return false;
+    }
+    frameSize = size;
+    return true;
+}
+
+qint64 ShmChannel::nextFrameSize() const {
+    return frameSize;
+}
+
+QByteArray ShmChannel::peekFrame() const {
+    if (frameSize < 0) return QByteArray();
+    return QByteArray::fromRawData(inData + ((readPos + 4) & (SHM_RING_BYTES - 1)), int(frameSize));
+}
+
+void ShmChannel::skipFrame() {
+    if (frameSize < 0) return;
+    readPos += 4 + quint32(frameSize);
+    frameSize = -1;
+    in->tail.store(readPos, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (in->writerWaiting.load(memory_order_relaxed) && in->writerWaiting.exchange(0)) wake();
+}
+
+#else
+
+ShmChannel::ShmChannel(QObject *parent) : QObject(parent) {}
+ShmChannel::~ShmChannel() {}
+bool ShmChannel::accept(qintptr) { return false; }
+bool ShmChannel::connectTo(const QString &) { return false; }
+bool ShmChannel::isOpen() const { return false; }
+bool ShmChannel::isConnected() const { return false; }
+void ShmChannel::close() {}
+bool ShmChannel::writeFrame(const QByteArray &) { return false; }
+void ShmChannel::flush() {}
+bool ShmChannel::hasFrame() { return false; }
+qint64 ShmChannel::nextFrameSize() const { return -1; }
+QByteArray ShmChannel::peekFrame() const { return QByteArray(); }
+void ShmChannel::skipFrame() {}
+
+#endif
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QSocketNotifier>
+using namespace std;
+
+// Bytes each direction can hold. Frames are never split, so nothing longer than this fits
+#define SHM_RING_BYTES (256 * 1024)
+
+// A connection to a process on the same host through shared memory, one single producer,
+// single consumer ring per direction. The rings carry the same frames as TCP, a 4 byte
+// length and then the message, so everything above the transport is unchanged.
+//
+// A local socket is used to hand over the memory (a memfd) and an eventfd per side, and after
+// that only to notice the other process going away. Each side sleeps on its eventfd and is only
+// written to when it said it was going to sleep, so a busy peer costs no system calls at all.
+// Linux only, elsewhere accept() and connectTo() fail.
+class ShmChannel : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(ShmChannel)
+public:
+    explicit ShmChannel(QObject *parent = nullptr);
+    ~ShmChannel();
+
+    // Server side, sets up the rings for a socket just accepted on the local server and passes
+    // them to the client. Closes the socket if that fails
+    bool accept(qintptr socketDescriptor);
+    // Client side, connected() follows once the server has passed the rings
+    bool connectTo(const QString &path);
+    bool isOpen() const;
+    // Open and past the handshake, so frames can be written
+    bool isConnected() const;
+    // Emits disconnected() if the channel was open
+    void close();
+
+    // frame is a whole frame including its length. False when there is not room for it,
+    // writable() is emitted once the peer has made some
+    bool writeFrame(const QByteArray &frame);
+    // Wakes the peer if it is waiting for frames, call once after a batch of writeFrame
+    void flush();
+
+    // True when a whole frame is waiting. When there is none the peer is asked to wake us
+    // (readyRead()) on its next write, so read until this is false before going back to the event loop
+    bool hasFrame();
+    // Length of the frame hasFrame() found, without its length prefix. -1 if there is none
+    qint64 nextFrameSize() const;
+    // The next frame's message, pointing into the ring. Only valid until skipFrame()
+    QByteArray peekFrame() const;
+    void skipFrame();
+
+signals:
+    void connected();
+    void readyRead();
+    void writable();
+    void disconnected();
+
+private:
+    // One direction. head and tail count bytes ever written and read, so they wrap at 2^32
+    // rather than at the ring size. The writer and reader halves are kept on their own cache lines
+    struct Ring {
+        alignas(64) atomic<quint32> head;
+        atomic<quint32> readerWaiting; // the reader is asleep, wake it after writing
+        alignas(64) atomic<quint32> tail;
+        atomic<quint32> writerWaiting; // the writer ran out of room, wake it after reading
+    };
+    struct Control {
+        quint32 magic;
+        quint32 ringBytes;
+        Ring rings[2]; // to the server, to the client
+    };
+
+    bool map(int memfd, bool server);
+    void unmap();
+    void wake();
+    void socketActivity();
+    void eventActivity();
+
+    int socketFd = -1;
+    int wakeFd = -1; // eventfd we sleep on
+    int peerFd = -1; // eventfd the peer sleeps on
+    QSocketNotifier *socketNotifier = nullptr;
+    QSocketNotifier *wakeNotifier = nullptr;
+
+    Control *control = nullptr;
+    Ring *in = nullptr;
+    Ring *out = nullptr;
+    // Each ring is mapped twice in a row, so frames that wrap past the end are still contiguous
+    char *inData = nullptr;
+    char *outData = nullptr;
+    // Our own positions, the shared ones are only ever written from these
+    quint32 readPos = 0;
+    quint32 writePos = 0;
+    qint64 frameSize = -1; // of the frame hasFrame() checked, -1 until it has
+    bool open = false;
+    bool blocked = false; // writeFrame failed, the peer has been asked to wake us when it reads
+};
@@ -0,0 +1,454 @@
+#include "wireprotocol.hpp"
+#include "messages.hpp"
+
+#include <QHash>
+#include <QJsonDocument>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+
+#define MESSAGE_TYPE(ID, TYPE, NAME, ENCODING) TYPE,
+const char* const message_types[] = { "", WIRE_MESSAGES(MESSAGE_TYPE) };
+#undef MESSAGE_TYPE
+
+// Enum fields are sent as their index in these tables, NONE when missing or unrecognised
+const quint8 NONE = 0xFF;
+#define ENUM_NAME(value) #value,
+const char* const action_names[] = { WIRE_ACTIONS(ENUM_NAME) };
+const char* const round_names[] = { WIRE_ROUNDS(ENUM_NAME) };
+#undef ENUM_NAME
+const char* const role_names[] = {"None", "D", "SB", "BB"};
+
+// Card strings are rank then suit, e.g. "TH", and are sent as suit * 13 + rank
+const char card_ranks[] = "23456789TJQKA";
+const char card_suits[] = "CDHS";
+
+void writeByte(QByteArray &out, quint8 value) {
+    out.append(char(value));
+}
+void writeVarint(QByteArray &out, quint32 value) {
+    while (value >= 0x80) {
+        writeByte(out, quint8(value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    writeByte(out, quint8(value));
+}
+// Amounts are zigzag encoded so that a stray negative value stays small
+void writeAmount(QByteArray &out, int value) {
+    writeVarint(out, (quint32(value) << 1) ^ quint32(value >> 31));
+}
+void writeId(QByteArray &out, int id) {
+    writeByte(out, id < 0 || id >= NONE ? NONE : quint8(id));
+}
+void writeString(QByteArray &out, const QString &value) {
+    const QByteArray utf8 = value.toUtf8();
+    writeVarint(out, quint32(utf8.size()));
+    out.append(utf8);
+}
+template <size_t N>
+void writeEnum(QByteArray &out, const QString &value, const char* const (&names)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+        if (value == QLatin1String(names[i])) {
+            writeByte(out, quint8(i));
+            return;
+        }
+    }
+    writeByte(out, NONE);
+}
+int charIndex(const char *chars, char c) {
+    for (int i = 0; chars[i]; ++i) {
+        if (chars[i] == c) return i;
+    }
+    return -1;
+}
+void writePlayers(QByteArray &out, const QVector<PlayerSeat> &players) {
+    writeByte(out, quint8(players.size()));
+    for (const PlayerSeat &seat : players) {
+        writeId(out, seat.player_id);
+        writeString(out, seat.username);
+        writeAmount(out, seat.stack);
+        writeEnum(out, seat.role, role_names);
+    }
+}
+
+// STATE_DELTA only carries the fields that changed, flagged in one byte
+enum DeltaField : quint8 {
+    DELTA_PLAYERS = 0x01,
+    DELTA_GAME_NO = 0x02,
+    DELTA_POT = 0x04,
+    DELTA_CURRENT_PLAYER = 0x08,
+    DELTA_TO_CALL = 0x10,
+    DELTA_BOARD_NEW = 0x20,
+    DELTA_BOARD_RESET = 0x40
+};
+
+// Cards that do not parse are left out
+void writeCards(QByteArray &out, const QStringList &cards) {
+    QByteArray indices;
+    for (const QString &card : cards) {
+        int rank = card.size() == 2 ? charIndex(card_ranks, card[0].toLatin1()) : -1;
+        int suit = card.size() == 2 ? charIndex(card_suits, card[1].toLatin1()) : -1;
+        if (rank >= 0 && suit >= 0) writeByte(indices, quint8(suit * 13 + rank));
+    }
+    writeByte(out, quint8(indices.size()));
+    out.append(indices);
+}
+
+class Reader
+{
+public:
+    Reader(const QByteArray &data, int offset) : data(data), pos(offset), failed(false) {}
+
+    // True once every byte has been read without running past the end
+    bool atEnd() const { return !failed && pos == data.size(); }
+
+    quint8 byte() {
+        if (pos >= data.size()) {
+            failed = true;
+            return 0;
+        }
+        return quint8(data[pos++]);
+    }
+    quint32 varint() {
+        quint32 value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            quint8 b = byte();
+            value |= quint32(b & 0x7F) << shift;
+            if (!(b & 0x80)) return value;
+        }
+        failed = true;
+        return 0;
+    }
+    int amount() {
+        quint32 value = varint();
+        return int((value >> 1) ^ (~(value & 1) + 1));
+    }
+    int id() {
+        quint8 value = byte();
+        return value == NONE ? -1 : value;
+    }
+    QString string() {
+        quint32 size = varint();
+        if (failed || size > quint32(data.size() - pos)) {
+            failed = true;
+            return QString();
+        }
+        QString value = QString::fromUtf8(data.constData() + pos, int(size));
+        pos += int(size);
+        return value;
+    }
+    template <size_t N>
+    QString enumName(const char* const (&names)[N]) {
+        quint8 value = byte();
+        return value < N ? QString::fromLatin1(names[value]) : QString();
+    }
+    QStringList cards() {
+        QStringList cards;
+        for (int count = byte(); count > 0 && !failed; --count) {
+            quint8 card = byte();
+            if (card >= 52) {
+                failed = true;
+                break;
+            }
+            cards.append(QString(QLatin1Char(card_ranks[card % 13])) + QLatin1Char(card_suits[card / 13]));
+        }
+        return cards;
+    }
+    QVector<PlayerSeat> players() {
+        QVector<PlayerSeat> players;
+        for (int count = byte(); count > 0 && !failed; --count) {
+            PlayerSeat seat;
+            seat.player_id = id();
+            seat.username = string();
+            seat.stack = amount();
+            seat.role = enumName(role_names);
+            players.append(seat);
+        }
+        return players;
+    }
+private:
+    const QByteArray &data;
+    int pos;
+    bool failed;
+};
+
+// The binary form of each field kind in messageschema.hpp
+void writeField(QByteArray &out, MessageField::Byte, int value) { writeByte(out, quint8(value)); }
+void writeField(QByteArray &out, MessageField::Id, int value) { writeId(out, value); }
+void writeField(QByteArray &out, MessageField::Amount, int value) { writeAmount(out, value); }
+void writeField(QByteArray &out, MessageField::TableId, int value) { writeAmount(out, value); }
+void writeField(QByteArray &out, MessageField::Varint, quint32 value) { writeVarint(out, value); }
+void writeField(QByteArray &out, MessageField::Seq, quint32 value) { writeVarint(out, value); }
+void writeField(QByteArray &out, MessageField::String, const QString &value) { writeString(out, value); }
+void writeField(QByteArray &out, MessageField::Action, WireProtocol::Action value) { writeByte(out, value < 0 ? NONE : quint8(value)); }
+void writeField(QByteArray &out, MessageField::Round, WireProtocol::Round value) { writeByte(out, value < 0 ? NONE : quint8(value)); }
+void writeField(QByteArray &out, MessageField::Cards, const QStringList &value) { writeCards(out, value); }
+void writeField(QByteArray &out, MessageField::Players, const QVector<PlayerSeat> &value) { writePlayers(out, value); }
+void writeField(QByteArray &out, MessageField::Winners, const MessageField::Winners::Type &value) {
+    writeByte(out, quint8(value.size()));
+    for (const pair<int, int> &winner : value) {
+        writeId(out, winner.first);
+        writeAmount(out, winner.second);
+    }
+}
+void writeField(QByteArray &out, MessageField::Flag, bool value) { writeByte(out, value ? 1 : 0); }
+
+int readField(Reader &in, MessageField::Byte) { return in.byte(); }
+int readField(Reader &in, MessageField::Id) { return in.id(); }
+int readField(Reader &in, MessageField::Amount) { return in.amount(); }
+int readField(Reader &in, MessageField::TableId) { return in.amount(); }
+quint32 readField(Reader &in, MessageField::Varint) { return in.varint(); }
+quint32 readField(Reader &in, MessageField::Seq) { return in.varint(); }
+QString readField(Reader &in, MessageField::String) { return in.string(); }
+WireProtocol::Action readField(Reader &in, MessageField::Action) {
+    const quint8 value = in.byte();
+    return value < WireProtocol::NUM_ACTIONS ? WireProtocol::Action(value) : WireProtocol::NO_ACTION;
+}
+WireProtocol::Round readField(Reader &in, MessageField::Round) {
+    const quint8 value = in.byte();
+    return value < WireProtocol::NUM_ROUNDS ? WireProtocol::Round(value) : WireProtocol::NO_ROUND;
+}
+QStringList readField(Reader &in, MessageField::Cards) { return in.cards(); }
+QVector<PlayerSeat> readField(Reader &in, MessageField::Players) { return in.players(); }
+MessageField::Winners::Type readField(Reader &in, MessageField::Winners) {
+    MessageField::Winners::Type winners;
+    for (int count = in.byte(); count > 0; --count) {
+        const int winner = in.id();
+        winners.append({winner, in.amount()});
+    }
+    return winners;
+}
+bool readField(Reader &in, MessageField::Flag) { return in.byte() != 0; }
+
+// Index of the end of the JSON string opening at start, or -1 if it runs off the end
+int skipJsonString(const char *data, int size, int start) {
+    for (int i = start + 1; i < size; ++i) {
+        if (data[i] == '\\') ++i;
+        else if (data[i] == '"') return i;
+    }
+    return -1;
+}
+
+int skipJsonSpace(const char *data, int size, int i) {
+    while (i < size && (data[i] == ' ' || data[i] == '\t' || data[i] == '\n' || data[i] == '\r')) ++i;
+    return i;
+}
+
+// The "type" of a JSON frame, found without parsing the rest. Only a key of the outermost
+// object counts, so nothing inside the payload can pass for it. UNKNOWN when there is no
+// such key or its value is not a plain string naming a message
+WireProtocol::MessageId peekJsonType(const QByteArray &frame) {
+    const char *data = frame.constData();
+    const int size = frame.size();
+    int depth = 0;
+    for (int i = 0; i < size; ++i) {
+        const char c = data[i];
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+        } else if (c == '"') {
+            const int end = skipJsonString(data, size, i);
+            if (end < 0) return WireProtocol::UNKNOWN;
+            const bool isType = depth == 1 && end - i == 5 && memcmp(data + i + 1, "type", 4) == 0;
+            i = end;
+            if (!isType) continue;
+            // A key is followed by a colon, a value of the same name is not
+            const int colon = skipJsonSpace(data, size, end + 1);
+            if (colon >= size || data[colon] != ':') continue;
+            const int value = skipJsonSpace(data, size, colon + 1);
+            if (value >= size || data[value] != '"') return WireProtocol::UNKNOWN;
+            const int valueEnd = skipJsonString(data, size, value);
+            if (valueEnd < 0) return WireProtocol::UNKNOWN;
+            const size_t length = size_t(valueEnd - value - 1);
+            for (int id = 1; id < WireProtocol::NUM_MESSAGE_IDS; ++id) {
+                if (strlen(message_types[id]) == length && memcmp(data + value + 1, message_types[id], length) == 0) return WireProtocol::MessageId(id);
+            }
+            return WireProtocol::UNKNOWN;
+        }
+    }
+    return WireProtocol::UNKNOWN;
+}
+
+template <size_t N>
+int enumIndex(const QString &name, const char* const (&names)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+        if (name == QLatin1String(names[i])) return int(i);
+    }
+    return -1;
+}
+
+}
+
+// Fields go straight between the typed message and their binary form, in the order of the schema
+#define WRITE_FIELD(kind, name) writeField(out, MessageField::kind(), encoded.name);
+#define READ_FIELD(kind, name) decoded.name = readField(in, MessageField::kind());
+#define ENCODE_BINARY(ID, NAME)                                         \
+    case ID: {                                                          \
+        const NAME##Message &encoded = get<NAME##Message>(message);     \
+        Q_UNUSED(encoded);                                              \
+        ID##_FIELDS(WRITE_FIELD)                                        \
+        return out;                                                     \
+    }
+#define DECODE_BINARY(ID, NAME)                                         \
+    case ID: {                                                          \
+        NAME##Message &decoded = message.emplace<NAME##Message>();      \
+        Q_UNUSED(decoded);                                              \
+        ID##_FIELDS(READ_FIELD)                                         \
+        break;                                                          \
+    }
+#define ENCODE_CUSTOM(ID, NAME)
+#define DECODE_CUSTOM(ID, NAME)
+#define ENCODE_JSON(ID, NAME)
+#define DECODE_JSON(ID, NAME)
+#define ENCODE_CASE(ID, TYPE, NAME, ENCODING) ENCODE_##ENCODING(ID, NAME)
+#define DECODE_CASE(ID, TYPE, NAME, ENCODING) DECODE_##ENCODING(ID, NAME)
+#define TO_JSON_CASE(ID, TYPE, NAME, ENCODING) case ID: json = get<NAME##Message>(message).toMessage(); break;
+#define FROM_JSON_CASE(ID, TYPE, NAME, ENCODING) case ID: message = NAME##Message::fromJson(payload); break;
+
+WireProtocol::MessageId WireProtocol::messageId(const QString &type) {
+    static const QHash<QString, MessageId> ids = []() {
+        QHash<QString, MessageId> table;
+        for (int i = 1; i < NUM_MESSAGE_IDS; ++i) table.insert(QString::fromLatin1(message_types[i]), MessageId(i));
+        return table;
+    }();
+    return ids.value(type, UNKNOWN);
+}
+
+WireProtocol::MessageId WireProtocol::messageId(const AnyMessage &message) {
+    return MessageId(message.index());
+}
+
+QString WireProtocol::messageType(MessageId id) {
+    return id < NUM_MESSAGE_IDS ? QString::fromLatin1(message_types[id]) : QString();
+}
+
+WireProtocol::Action WireProtocol::action(const QString &name) {
+    return Action(enumIndex(name, action_names));
+}
+
+QString WireProtocol::actionName(Action action) {
+    return action >= 0 && action < NUM_ACTIONS ? QString::fromLatin1(action_names[action]) : QString();
+}
+
+WireProtocol::Round WireProtocol::round(const QString &name) {
+    return Round(enumIndex(name, round_names));
+}
+
+QString WireProtocol::roundName(Round round) {
+    return round >= 0 && round < NUM_ROUNDS ? QString::fromLatin1(round_names[round]) : QString();
+}
+
+bool WireProtocol::isBinary(const QByteArray &frame) {
+    return !frame.isEmpty() && quint8(frame[0]) >= 1 && quint8(frame[0]) <= WIRE_PROTOCOL_VERSION;
+}
+
+WireProtocol::MessageId WireProtocol::peekMessageId(const QByteArray &frame) {
+    if (!isBinary(frame)) return peekJsonType(frame);
+    if (frame.size() < 2 || quint8(frame[1]) >= NUM_MESSAGE_IDS) return UNKNOWN;
+    return MessageId(quint8(frame[1]));
+}
+
+QByteArray WireProtocol::encode(const AnyMessage &message, int version) {
+
+    const MessageId id = messageId(message);
+    if (version > 0) {
+        QByteArray out;
+        out.reserve(32);
+        writeByte(out, quint8(qMin(version, WIRE_PROTOCOL_VERSION)));
+        writeByte(out, id);
+
+        switch (id) {
+        WIRE_MESSAGES(ENCODE_CASE)
+        case STATE_DELTA: {
+            const StateDeltaMessage &delta = get<StateDeltaMessage>(message);
+            writeVarint(out, delta.version);
+            quint8 fields = 0;
+            if (!delta.players.isEmpty()) fields |= DELTA_PLAYERS;
+            if (delta.game_no) fields |= DELTA_GAME_NO;
+            if (delta.pot) fields |= DELTA_POT;
+            if (delta.current_player) fields |= DELTA_CURRENT_PLAYER;
+            if (delta.to_call) fields |= DELTA_TO_CALL;
+            if (!delta.board_new.isEmpty()) fields |= DELTA_BOARD_NEW;
+            if (delta.board_reset) fields |= DELTA_BOARD_RESET;
+            writeByte(out, fields);
+            if (fields & DELTA_PLAYERS) writePlayers(out, delta.players);
+            if (fields & DELTA_GAME_NO) writeAmount(out, *delta.game_no);
+            if (fields & DELTA_POT) writeAmount(out, *delta.pot);
+            if (fields & DELTA_CURRENT_PLAYER) writeId(out, *delta.current_player);
+            if (fields & DELTA_TO_CALL) writeAmount(out, *delta.to_call);
+            if (fields & DELTA_BOARD_NEW) writeCards(out, delta.board_new);
+            return out;
+        }
+        default:
+            break;
+        }
+    }
+
+    QJsonObject json;
+    switch (id) {
+    WIRE_MESSAGES(TO_JSON_CASE)
+    default:
+        break;
+    }
+    return QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+bool WireProtocol::decode(const QByteArray &frame, AnyMessage &message) {
+
+    // The one place a message type is looked up by name, binary frames carry their id
+    if (!isBinary(frame)) {
+        QJsonParseError parseError;
+        const QJsonDocument jsonDoc = QJsonDocument::fromJson(frame, &parseError);
+        if (parseError.error != QJsonParseError::NoError || !jsonDoc.isObject()) return false;
+        const QJsonObject json = jsonDoc.object();
+        const QJsonObject payload = json.value(QLatin1String("payload")).toObject();
+        switch (messageId(json.value(QLatin1String("type")).toString())) {
+        WIRE_MESSAGES(FROM_JSON_CASE)
+        default:
+            return false;
+        }
+        return true;
+    }
+
+    if (frame.size() < 2) return false;
+    const MessageId id = MessageId(quint8(frame[1]));
+    Reader in(frame, 2);
+
+    switch (id) {
+    WIRE_MESSAGES(DECODE_CASE)
+    case STATE_DELTA: {
+        StateDeltaMessage &delta = message.emplace<StateDeltaMessage>();
+        delta.version = in.varint();
+        const quint8 fields = in.byte();
+        if (fields & DELTA_PLAYERS) delta.players = in.players();
+        if (fields & DELTA_GAME_NO) delta.game_no = in.amount();
+        if (fields & DELTA_POT) delta.pot = in.amount();
+        if (fields & DELTA_CURRENT_PLAYER) delta.current_player = in.id();
+        if (fields & DELTA_TO_CALL) delta.to_call = in.amount();
+        if (fields & DELTA_BOARD_NEW) delta.board_new = in.cards();
+        delta.board_reset = fields & DELTA_BOARD_RESET;
+        break;
+    }
+    default:
+        return false;
+    }
+
+    return in.atEnd();
+}
+
+QByteArray WireProtocol::frame(const QByteArray &encoded) {
+    QByteArray framed(4 + encoded.size(), Qt::Uninitialized);
+    qToBigEndian<quint32>(quint32(encoded.size()), framed.data());
+    memcpy(framed.data() + 4, encoded.constData(), size_t(encoded.size()));
+    return framed;
+}
+
+QJsonObject WireProtocol::message(MessageId id, const QJsonObject &payload) {
+    QJsonObject message;
+    message[QLatin1String("type")] = messageType(id);
+    message[QLatin1String("payload")] = payload;
+    return message;
+}
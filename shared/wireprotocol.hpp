@@ -0,0 +1,88 @@
+#pragma once
+
+#include <variant>
+
+#include <QByteArray>
+#include <QJsonObject>
+
+#include "messageschema.hpp"
+using namespace std;
+
+// Compact binary encoding of the messages in json_message_formats.txt, as laid out
+// in messageschema.hpp.
+//
+// Every frame is still sent as a QDataStream QByteArray, so it is length prefixed.
+// A binary frame starts with the protocol version byte followed by a message id,
+// then the payload fields in a fixed order: player ids and enums are single bytes,
+// cards are one byte (Card::to_index), amounts are varints and strings are a varint
+// length followed by UTF-8. A JSON frame always starts with '{' or whitespace, so
+// both encodings can be read on the same connection.
+//
+// The binary encoding is negotiated with a HELLO message sent as JSON when the
+// client connects. Until both sides have agreed on a version, or if either side
+// asks for version 0, messages are sent as compact JSON, which stays readable for
+// debugging.
+//
+// Messages are encoded from and decoded into the typed messages in messages.hpp
+// directly, a binary frame never goes through JSON.
+
+#define WIRE_PROTOCOL_VERSION 2
+
+// The typed messages, see messages.hpp. An AnyMessage holds any one of them, and the
+// index of the alternative it holds is its WireProtocol::MessageId
+#define WIRE_MESSAGE_DECLARATION(id, type, name, encoding) struct name##Message;
+WIRE_MESSAGES(WIRE_MESSAGE_DECLARATION)
+#undef WIRE_MESSAGE_DECLARATION
+#define WIRE_MESSAGE_ALTERNATIVE(id, type, name, encoding) , name##Message
+typedef variant<monostate WIRE_MESSAGES(WIRE_MESSAGE_ALTERNATIVE)> AnyMessage;
+#undef WIRE_MESSAGE_ALTERNATIVE
+
+class WireProtocol
+{
+public:
+#define WIRE_MESSAGE_ID(id, type, name, encoding) id,
+    enum MessageId : quint8 {
+        UNKNOWN = 0,
+        WIRE_MESSAGES(WIRE_MESSAGE_ID)
+        NUM_MESSAGE_IDS
+    };
+#undef WIRE_MESSAGE_ID
+
+    // Enum fields, NO_ACTION and NO_ROUND when missing or unrecognised
+#define WIRE_ENUM_VALUE(value) ACTION_##value,
+    enum Action : qint8 { NO_ACTION = -1, WIRE_ACTIONS(WIRE_ENUM_VALUE) NUM_ACTIONS };
+#undef WIRE_ENUM_VALUE
+#define WIRE_ENUM_VALUE(value) ROUND_##value,
+    enum Round : qint8 { NO_ROUND = -1, WIRE_ROUNDS(WIRE_ENUM_VALUE) NUM_ROUNDS };
+#undef WIRE_ENUM_VALUE
+
+    // Hash lookup, UNKNOWN for a type that is not in the schema
+    static MessageId messageId(const QString &type);
+    static MessageId messageId(const AnyMessage &message);
+    static QString messageType(MessageId id);
+    static Action action(const QString &name);
+    static QString actionName(Action action);
+    static Round round(const QString &name);
+    static QString roundName(Round round);
+
+    static bool isBinary(const QByteArray &frame);
+    // The id of a frame without decoding it: a binary frame's second byte, or the outermost
+    // "type" of a JSON frame found by a scan that allocates nothing. UNKNOWN when the frame
+    // names no message in the schema, which decode() would reject as well
+    static MessageId peekMessageId(const QByteArray &frame);
+
+    // Encodes with the given binary version, or as compact JSON when version is 0
+    // or the message type has no binary schema
+    static QByteArray encode(const AnyMessage &message, int version);
+
+    // Decodes either encoding, returns false if the frame is malformed or its type
+    // is not in the schema
+    static bool decode(const QByteArray &frame, AnyMessage &message);
+
+    // Prefixes an encoded message with its length exactly as QDataStream writes a
+    // QByteArray, so the result can be written to any number of sockets as is
+    static QByteArray frame(const QByteArray &encoded);
+
+    // {"type": ..., "payload": payload}, the JSON form of a message
+    static QJsonObject message(MessageId id, const QJsonObject &payload);
+};
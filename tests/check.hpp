@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdio>
+using namespace std;
+
+// Just enough of a test harness for the game code, which builds without Qt.
+// A failed CHECK is reported and the test carries on, the run fails at the end
+
+typedef void (*TestFunction)();
+
+struct TestCase {
+    TestCase(const char* name, TestFunction run);
+};
+
+extern int check_failures;
+
+#define TEST(name) \
+    static void name(); \
+    static TestCase name##_case(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            check_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        long long actual_value = (long long)(actual); \
+        long long expected_value = (long long)(expected); \
+        if (actual_value != expected_value) { \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed, %lld != %lld\n", __FILE__, __LINE__, \
+                    #actual, #expected, actual_value, expected_value); \
+            check_failures++; \
+        } \
+    } while (0)
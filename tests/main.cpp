@@ -0,0 +1,34 @@
+#include <vector>
+#include "check.hpp"
+using namespace std;
+
+int check_failures = 0;
+
+namespace {
+struct RegisteredTest {
+    const char* name;
+    TestFunction run;
+};
+
+vector<RegisteredTest>& registered_tests() {
+    static vector<RegisteredTest> tests;
+    return tests;
+}
+}
+
+TestCase::TestCase(const char* name, TestFunction run) {
+    registered_tests().push_back({name, run});
+}
+
+int main() {
+    int failed_tests = 0;
+    for (const RegisteredTest& test : registered_tests()) {
+        int failures_before = check_failures;
+        test.run();
+        bool passed = check_failures == failures_before;
+        if (!passed) failed_tests++;
+        printf("%s %s\n", passed ? "PASS" : "FAIL", test.name);
+    }
+    printf("%d of %d tests failed\n", failed_tests, int(registered_tests().size()));
+    return failed_tests == 0 ? 0 : 1;
+}
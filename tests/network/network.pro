@@ -0,0 +1,65 @@
+QT       += core network testlib
+QT       -= gui
+
+TARGET = network_tests
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+# Tests of the server and client talking over a real socket, run them with make check
+
+SERVER_DIR = ../../server
+CLIENT_DIR = ../../client
+SHARED_DIR = ../../shared
+
+INCLUDEPATH += $$SERVER_DIR $$CLIENT_DIR $$SHARED_DIR
+
+SOURCES += \
+    test_session.cpp \
+    $$SERVER_DIR/cards.cpp \
+    $$SERVER_DIR/engine.cpp \
+    $$SERVER_DIR/evaluate.cpp \
+    $$SERVER_DIR/game.cpp \
+    $$SERVER_DIR/housebots.cpp \
+    $$SERVER_DIR/ioshard.cpp \
+    $$SERVER_DIR/logger.cpp \
+    $$SERVER_DIR/metrics.cpp \
+    $$SERVER_DIR/player.cpp \
+    $$SERVER_DIR/publicstate.cpp \
+    $$SERVER_DIR/pots.cpp \
+    $$SERVER_DIR/server.cpp \
+    $$SERVER_DIR/serverworker.cpp \
+    $$SERVER_DIR/tablestate.cpp \
+    $$SERVER_DIR/timerwheel.cpp \
+    $$SERVER_DIR/trace.cpp \
+    $$SERVER_DIR/zobrist.cpp \
+    $$CLIENT_DIR/client.cpp \
+    $$SHARED_DIR/wireprotocol.cpp \
+    $$SHARED_DIR/messages.cpp \
+    $$SHARED_DIR/shmchannel.cpp
+
+HEADERS += \
+    $$SERVER_DIR/botapi.hpp \
+    $$SERVER_DIR/cards.hpp \
+    $$SERVER_DIR/engine.hpp \
+    $$SERVER_DIR/evaluate.hpp \
+    $$SERVER_DIR/game.hpp \
+    $$SERVER_DIR/housebots.hpp \
+    $$SERVER_DIR/ioshard.hpp \
+    $$SERVER_DIR/logger.hpp \
+    $$SERVER_DIR/metrics.hpp \
+    $$SERVER_DIR/player.hpp \
+    $$SERVER_DIR/publicstate.hpp \
+    $$SERVER_DIR/pots.hpp \
+    $$SERVER_DIR/server.hpp \
+    $$SERVER_DIR/serverworker.hpp \
+    $$SERVER_DIR/session.hpp \
+    $$SERVER_DIR/tablestate.hpp \
+    $$SERVER_DIR/timerwheel.hpp \
+    $$SERVER_DIR/trace.hpp \
+    $$SERVER_DIR/zobrist.hpp \
+    $$CLIENT_DIR/client.hpp \
+    $$SHARED_DIR/wireprotocol.hpp \
+    $$SHARED_DIR/messages.hpp \
+    $$SHARED_DIR/messageschema.hpp \
+    $$SHARED_DIR/shmchannel.hpp
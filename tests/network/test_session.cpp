@@ -0,0 +1,116 @@
+#include <QtTest>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QVector>
+
+#include "client.hpp"
+#include "server.hpp"
+#include "wireprotocol.hpp"
+using namespace std;
+
+// How long a connection is watched for traffic that should not come
+#define QUIET_MS 500
+
+// Frames are length prefixed QByteArrays, the same way Client and ServerWorker write them
+static void send(QTcpSocket *socket, const AnyMessage &message) {
+    QDataStream stream(socket);
+    stream.setVersion(CLIENT_VERSION);
+    stream << WireProtocol::encode(message, 0);
+}
+
+// Everything that arrives on socket within ms. The event loop keeps running meanwhile, the
+// server's tables and the client live on this thread too
+static QVector<AnyMessage> receive(QTcpSocket *socket, int ms) {
+    QVector<AnyMessage> received;
+    QDataStream stream(socket);
+    stream.setVersion(CLIENT_VERSION);
+    QElapsedTimer timer;
+    timer.start();
+    do {
+        QTest::qWait(10);
+        for (;;) {
+            QByteArray frame;
+            stream.startTransaction();
+            stream >> frame;
+            if (!stream.commitTransaction()) break;
+            AnyMessage message;
+            if (WireProtocol::decode(frame, message)) received.append(message);
+        }
+    } while (timer.elapsed() < ms);
+    return received;
+}
+
+class TestSession : public QObject
+{
+    Q_OBJECT
+private slots:
+    void refusedJoinGetsOneError();
+    void clientStopsAfterRefusedJoin();
+    void clientAndServerGoQuietAfterRefusedJoin();
+};
+
+// The server answers a refused join once and has no state to send a connection without a table
+void TestSession::refusedJoinGetsOneError() {
+    Server server(nullptr, 1, 1);
+    QVERIFY(server.startServer(0));
+
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(socket.waitForConnected());
+
+    send(&socket, JoinGameRequestMessage());
+    QVector<AnyMessage> received = receive(&socket, QUIET_MS);
+    QCOMPARE(received.size(), 1);
+    QVERIFY(holds_alternative<ErrorMessage>(received[0]));
+
+    send(&socket, RequestStateMessage());
+    QVERIFY(receive(&socket, QUIET_MS).isEmpty());
+}
+
+// After an ERROR for its join, the client sends nothing more on its own
+void TestSession::clientStopsAfterRefusedJoin() {
+    QTcpServer fake;
+    QVERIFY(fake.listen(QHostAddress::LocalHost));
+
+    Client client;
+    QSignalSpy connected(&client, &Client::connected);
+    QSignalSpy errors(&client, &Client::serverError);
+    client.set_binary_protocol(false);
+    client.connectToServer(QHostAddress::LocalHost, fake.serverPort());
+    QTRY_COMPARE(connected.count(), 1);
+    QTRY_VERIFY(fake.hasPendingConnections());
+    QTcpSocket *socket = fake.nextPendingConnection();
+
+    client.login(QStringLiteral("refused"));
+    const QVector<AnyMessage> received = receive(socket, QUIET_MS);
+    QVERIFY(!received.isEmpty());
+    QVERIFY(holds_alternative<JoinGameRequestMessage>(received.last()));
+
+    ErrorMessage error;
+    error.message = QStringLiteral("Every table is full");
+    send(socket, error);
+    QTRY_COMPARE(errors.count(), 1);
+    QVERIFY(receive(socket, QUIET_MS).isEmpty());
+}
+
+void TestSession::clientAndServerGoQuietAfterRefusedJoin() {
+    Server server(nullptr, 1, 1);
+    QVERIFY(server.startServer(0));
+
+    Client client;
+    QSignalSpy connected(&client, &Client::connected);
+    QSignalSpy errors(&client, &Client::serverError);
+    client.connectToServer(QHostAddress::LocalHost, server.serverPort());
+    QTRY_COMPARE(connected.count(), 1);
+
+    client.login(QString());
+    QTRY_COMPARE(errors.count(), 1);
+    QTest::qWait(QUIET_MS);
+    QCOMPARE(errors.count(), 1);
+}
+
+QTEST_GUILESS_MAIN(TestSession)
+#include "test_session.moc"
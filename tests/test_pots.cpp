@@ -0,0 +1,160 @@
+#include <cstdint>
+#include "check.hpp"
+#include "pots.hpp"
+using namespace std;
+
+namespace {
+
+// A table at showdown, seats with a negative contribution folded after putting in that much
+TableState showdown(int num_players, const int contributions[], int dealer) {
+    TableState table;
+    table.init(num_players, 0);
+    table.active_mask = 0;
+    for (int i = 0; i < num_players; ++i) {
+        table.contributed[i] = contributions[i] < 0 ? -contributions[i] : contributions[i];
+        if (contributions[i] >= 0) table.active_mask |= seat_bit(i);
+    }
+    table.dealer_index = dealer;
+    return table;
+}
+
+int total(const int amounts[], int n) {
+    int sum = 0;
+    for (int i = 0; i < n; ++i) sum += amounts[i];
+    return sum;
+}
+
+}
+
+TEST(all_ins_make_a_side_pot_per_level) {
+    const int contributions[] = {50, 100, 200, 200};
+    TableState table = showdown(4, contributions, 0);
+    Pot pots[MAXPLAYERS];
+    CHECK_EQ(build_pots(table, pots), 3);
+    CHECK_EQ(pots[0].amount, 200);
+    CHECK_EQ(pots[0].eligible, seat_bit(0) | seat_bit(1) | seat_bit(2) | seat_bit(3));
+    CHECK_EQ(pots[1].amount, 150);
+    CHECK_EQ(pots[1].eligible, seat_bit(1) | seat_bit(2) | seat_bit(3));
+    CHECK_EQ(pots[2].amount, 200);
+    CHECK_EQ(pots[2].eligible, seat_bit(2) | seat_bit(3));
+
+    // The short stack has the best hand, the seat covering everyone the worst
+    const int rank[MAXPLAYERS] = {1, 2, 3, 4, 0, 0};
+    int payouts[MAXPLAYERS];
+    settle_pots(table, pots, 3, rank, payouts);
+    CHECK_EQ(payouts[0], 200);
+    CHECK_EQ(payouts[1], 150);
+    CHECK_EQ(payouts[2], 200);
+    CHECK_EQ(payouts[3], 0);
+    CHECK_EQ(pots[0].winners, seat_bit(0));
+    CHECK_EQ(pots[2].winners, seat_bit(2));
+}
+
+TEST(folded_chips_stay_in_the_pot_they_reached) {
+    const int contributions[] = {50, 100, 100, -80};
+    TableState table = showdown(4, contributions, 0);
+    Pot pots[MAXPLAYERS];
+    CHECK_EQ(build_pots(table, pots), 2);
+    CHECK_EQ(pots[0].amount, 200);
+    CHECK_EQ(pots[0].eligible, seat_bit(0) | seat_bit(1) | seat_bit(2));
+    CHECK_EQ(pots[1].amount, 130);
+    CHECK_EQ(pots[1].eligible, seat_bit(1) | seat_bit(2));
+}
+
+TEST(split_pot_gives_odd_chips_left_of_the_dealer) {
+    const int contributions[] = {25, 25, 25, -2};
+    const int rank[MAXPLAYERS] = {0, 1, 0, 0, 0, 0};
+    Pot pots[MAXPLAYERS];
+    int payouts[MAXPLAYERS];
+
+    TableState table = showdown(4, contributions, 2);
+    CHECK_EQ(build_pots(table, pots), 1);
+    CHECK_EQ(pots[0].amount, 77);
+    settle_pots(table, pots, 1, rank, payouts);
+    CHECK_EQ(pots[0].winners, seat_bit(0) | seat_bit(2));
+    CHECK_EQ(payouts[0], 39);
+    CHECK_EQ(payouts[2], 38);
+
+    table.dealer_index = 0;
+    settle_pots(table, pots, 1, rank, payouts);
+    CHECK_EQ(payouts[0], 38);
+    CHECK_EQ(payouts[2], 39);
+}
+
+TEST(split_side_pot_behind_a_short_all_in) {
+    // Seats 1 and 2 tie above the short stack, so they split the side pot and
+    // the chips seat 2 alone put in
+    const int contributions[] = {30, 100, 101};
+    const int rank[MAXPLAYERS] = {0, 1, 1, 0, 0, 0};
+    TableState table = showdown(3, contributions, 1);
+    Pot pots[MAXPLAYERS];
+    int payouts[MAXPLAYERS];
+    int num_pots = build_pots(table, pots);
+    CHECK_EQ(num_pots, 3);
+    settle_pots(table, pots, num_pots, rank, payouts);
+    CHECK_EQ(payouts[0], 90);
+    CHECK_EQ(payouts[1], 70);
+    CHECK_EQ(payouts[2], 71);
+}
+
+TEST(pots_from_a_played_hand) {
+    TableState table;
+    table.init(3, INITIALSTACK);
+    table.stack[0] = 40;
+    table.stack[1] = 120;
+    table.start_hand();
+    table.post_blind(SMALLBLIND);
+    table.post_blind(BIGBLIND - SMALLBLIND);
+    // Everyone shoves in turn
+    while (!table.betting_over()) {
+        LegalActions legal = table.legal_actions();
+        Action action = legal.can(RAISE) ? Action(RAISE, legal.max_raise) : Action(CALL, 0);
+        CHECK_EQ(table.make_action(action), 0);
+    }
+    CHECK_EQ(table.allin_mask, seat_bit(0) | seat_bit(1) | seat_bit(2));
+
+    Pot pots[MAXPLAYERS];
+    int num_pots = build_pots(table, pots);
+    CHECK_EQ(num_pots, 3);
+    CHECK_EQ(pots[0].amount, 120);
+    CHECK_EQ(pots[1].amount, 160);
+    CHECK_EQ(pots[2].amount, 80);
+    CHECK_EQ(pots[0].amount + pots[1].amount + pots[2].amount, table.pot);
+}
+
+TEST(settlement_pays_out_every_chip) {
+    uint32_t seed = 777;
+    auto next_random = [&seed](int bound) {
+        seed = seed * 1103515245 + 12345;
+        return int((seed >> 16) % bound);
+    };
+    for (int hand = 0; hand < 1000; ++hand) {
+        int num_players = 2 + next_random(MAXPLAYERS - 1);
+        int contributions[MAXPLAYERS];
+        int rank[MAXPLAYERS] = {0, 0, 0, 0, 0, 0};
+        for (int i = 0; i < num_players; ++i) {
+            contributions[i] = 1 + next_random(50);
+            rank[i] = next_random(3);
+        }
+        // Seat 0 stays in so that every hand has someone to win it
+        for (int i = 1; i < num_players; ++i) {
+            if (next_random(4) == 0) contributions[i] = -contributions[i];
+        }
+        TableState table = showdown(num_players, contributions, next_random(num_players));
+
+        Pot pots[MAXPLAYERS];
+        int payouts[MAXPLAYERS];
+        int num_pots = build_pots(table, pots);
+        settle_pots(table, pots, num_pots, rank, payouts);
+
+        CHECK_EQ(total(payouts, MAXPLAYERS), total(table.contributed, MAXPLAYERS));
+        for (int p = 0; p < num_pots; ++p) {
+            CHECK(pots[p].winners != 0);
+            CHECK_EQ(pots[p].winners & ~pots[p].eligible, 0);
+            if (p > 0) CHECK_EQ(pots[p].eligible & ~pots[p - 1].eligible, 0);
+        }
+        for (int i = 0; i < MAXPLAYERS; ++i) {
+            if (table.has_folded(i)) CHECK_EQ(payouts[i], 0);
+        }
+    }
+}
@@ -0,0 +1,251 @@
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "check.hpp"
+#include "tablestate.hpp"
+#include "zobrist.hpp"
+using namespace std;
+
+namespace {
+
+// Starts a hand the way GameState does, with the blinds posted and two cards dealt to each seat
+TableState new_hand(int num_players, int init_stack = INITIALSTACK) {
+    TableState state;
+    state.init(num_players, init_stack);
+    state.start_hand();
+    state.post_blind(SMALLBLIND);
+    state.post_blind(BIGBLIND - SMALLBLIND);
+    for (int i = 0; i < num_players; ++i) {
+        state.deal_hole_cards(i, Card::from_index(2 * i), Card::from_index(2 * i + 1));
+    }
+    return state;
+}
+
+bool same_state(const TableState& a, const TableState& b) {
+    if (a.num_players != b.num_players || a.round != b.round || a.pot != b.pot || !(a.board == b.board)) return false;
+    for (int i = 0; i < MAXPLAYERS; ++i) {
+        if (a.stack[i] != b.stack[i] || a.to_call[i] != b.to_call[i] || a.contributed[i] != b.contributed[i]) return false;
+        if (!(a.hole_cards[i] == b.hole_cards[i])) return false;
+    }
+    return a.seated_mask == b.seated_mask && a.active_mask == b.active_mask && a.acted_mask == b.acted_mask
+        && a.allin_mask == b.allin_mask && a.current_player_index == b.current_player_index
+        && a.dealer_index == b.dealer_index && a.sb_index == b.sb_index && a.bb_index == b.bb_index
+        && a.last_raiser_index == b.last_raiser_index && a.hash == b.hash && a.num_actions == b.num_actions;
+}
+
+// Everything the player to act may do, with raises at the smallest, a middle and the all in size
+vector<Action> candidate_actions(const TableState& state) {
+    vector<Action> actions;
+    LegalActions legal = state.legal_actions();
+    for (ActionType type : {FOLD, CALL, CHECK}) {
+        if (legal.can(type)) actions.push_back(Action(type, 0));
+    }
+    if (legal.can(RAISE)) {
+        actions.push_back(Action(RAISE, legal.min_raise));
+        if (legal.max_raise > legal.min_raise + 1) actions.push_back(Action(RAISE, (legal.min_raise + legal.max_raise) / 2));
+        if (legal.max_raise > legal.min_raise) actions.push_back(Action(RAISE, legal.max_raise));
+    }
+    return actions;
+}
+
+// Plays every line depth actions deep, checking that each unmake puts back the state it started from.
+// Returns the number of actions made
+int walk(TableState& state, int depth) {
+    if (depth == 0) return 0;
+    int made = 0;
+    for (const Action& action : candidate_actions(state)) {
+        TableState before = state;
+        TableState undo;
+        CHECK_EQ(state.make_action(action, undo), 0);
+        CHECK(same_state(undo, before));
+        made += 1 + walk(state, depth - 1);
+        state.unmake_action(undo);
+        CHECK(same_state(state, before));
+    }
+    return made;
+}
+
+}
+
+TEST(make_unmake_restores_every_line) {
+    TableState state = new_hand(3);
+    TableState start = state;
+    CHECK(walk(state, 5) > 100);
+    CHECK(same_state(state, start));
+}
+
+TEST(make_unmake_restores_all_in) {
+    TableState state = new_hand(2, 20);
+    TableState start = state;
+    LegalActions legal = state.legal_actions();
+    TableState undo;
+    CHECK_EQ(state.make_action(Action(RAISE, legal.max_raise), undo), 0);
+    CHECK_EQ(state.stack[start.current_player_index], 0);
+    CHECK(state.allin_mask & seat_bit(start.current_player_index));
+    state.unmake_action(undo);
+    CHECK(same_state(state, start));
+    CHECK_EQ(state.allin_mask, 0);
+}
+
+TEST(rejected_action_leaves_state_untouched) {
+    TableState state = new_hand(3);
+    TableState start = state;
+    LegalActions legal = state.legal_actions();
+    CHECK(legal.call_amount > 0);
+    CHECK_EQ(state.make_action(Action(CHECK, 0)), -1);
+    CHECK_EQ(state.make_action(Action(RAISE, legal.min_raise - 1)), -1);
+    CHECK_EQ(state.make_action(Action(RAISE, legal.max_raise + 1)), -1);
+    CHECK(same_state(state, start));
+}
+
+TEST(snapshot_is_independent_of_the_table) {
+    TableState state = new_hand(3);
+    TableState snapshot = state;
+    int folder = state.current_player_index;
+    CHECK_EQ(snapshot.make_action(Action(FOLD, 0)), 0);
+    CHECK(snapshot.has_folded(folder));
+    CHECK(!state.has_folded(folder));
+    CHECK(!same_state(state, snapshot));
+}
+
+TEST(next_and_prev_wrap_around_the_table) {
+    TableState state;
+    state.init(MAXPLAYERS, INITIALSTACK);
+    SeatMask mask = seat_bit(1) | seat_bit(3) | seat_bit(4);
+    CHECK_EQ(state.next_in(mask, 1), 3);
+    CHECK_EQ(state.next_in(mask, 2), 3);
+    CHECK_EQ(state.next_in(mask, 4), 1);
+    CHECK_EQ(state.next_in(mask, 5), 1);
+    CHECK_EQ(state.next_in(mask, -1), 1);
+    CHECK_EQ(state.prev_in(mask, 3), 1);
+    CHECK_EQ(state.prev_in(mask, 1), 4);
+    CHECK_EQ(state.prev_in(mask, 0), 4);
+    CHECK_EQ(state.next_in(0, 2), 2);
+}
+
+TEST(seat_status_follows_the_masks) {
+    TableState state = new_hand(3, 20);
+    int folder = state.current_player_index;
+    CHECK_EQ(state.get_status(folder), ACTIVE);
+    CHECK_EQ(state.make_action(Action(FOLD, 0)), 0);
+    CHECK_EQ(state.get_status(folder), FOLDED);
+
+    int shover = state.current_player_index;
+    CHECK_EQ(state.make_action(Action(RAISE, state.legal_actions().max_raise)), 0);
+    CHECK_EQ(state.get_status(shover), ALLIN);
+    CHECK(state.active_mask & seat_bit(shover));
+    CHECK(!(state.to_act_mask() & seat_bit(shover)));
+    CHECK(!(state.to_act_mask() & seat_bit(folder)));
+    CHECK_EQ(state.num_in_hand(), 2);
+    CHECK_EQ(state.get_status(4), EMPTY);
+}
+
+TEST(seats_are_reused_lowest_first) {
+    TableState state;
+    state.init(2, INITIALSTACK);
+    CHECK_EQ(state.seat_player(INITIALSTACK), 2);
+    state.unseat_player(0);
+    CHECK_EQ(state.get_status(0), EMPTY);
+    // Seats start out in the hand, so the chips only leave when the next one starts
+    CHECK_EQ(state.seat_player(INITIALSTACK), 3);
+    CHECK_EQ(state.start_hand(), 3);
+    CHECK_EQ(state.stack[0], 0);
+    CHECK_EQ(state.seat_player(50), 0);
+    CHECK_EQ(state.stack[0], 50);
+    for (int i = 4; i < MAXPLAYERS; ++i) CHECK_EQ(state.seat_player(INITIALSTACK), i);
+    CHECK_EQ(state.seat_player(INITIALSTACK), -1);
+}
+
+TEST(unseated_player_stays_in_the_hand_until_it_folds) {
+    TableState state = new_hand(3);
+    int leaver = state.current_player_index;
+    state.unseat_player(leaver);
+    CHECK_EQ(state.get_status(leaver), EMPTY);
+    CHECK(state.active_mask & seat_bit(leaver));
+    CHECK_EQ(state.seat_player(INITIALSTACK), 3);
+    CHECK_EQ(state.make_action(Action(FOLD, 0)), 0);
+    CHECK_EQ(state.seat_player(INITIALSTACK), leaver);
+}
+
+TEST(start_hand_deals_in_only_seats_with_chips) {
+    TableState state;
+    state.init(4, INITIALSTACK);
+    state.stack[1] = 0;
+    CHECK_EQ(state.start_hand(), 3);
+    CHECK_EQ(state.active_mask, seat_bit(0) | seat_bit(2) | seat_bit(3));
+    CHECK_EQ(state.dealer_index, 0);
+    CHECK_EQ(state.sb_index, 2);
+    CHECK_EQ(state.bb_index, 3);
+    CHECK_EQ(state.start_hand(), 3);
+    CHECK_EQ(state.dealer_index, 2);
+}
+
+namespace {
+
+typedef vector<pair<int, Action>> History;
+
+// The hash worked out from scratch, to hold the incremental one to
+uint64_t full_hash(const TableState& state, const History& history) {
+    uint64_t hash = zobrist_keys.round[state.round] ^ zobrist_cards(zobrist_keys.board, state.board);
+    for (int i = 0; i < state.num_players; ++i) {
+        hash ^= zobrist_keys.stack[i][zobrist_stack_bucket(state.stack[i])];
+        hash ^= zobrist_cards(zobrist_keys.hole_cards[i], state.hole_cards[i]);
+    }
+    if (state.current_player_index >= 0) hash ^= zobrist_keys.current_player[state.current_player_index];
+    for (size_t ply = 0; ply < history.size(); ++ply) {
+        const Action& action = history[ply].second;
+        hash ^= zobrist_keys.action[ply % ZOBRIST_MAX_PLY][history[ply].first][action.type];
+        if (action.type == RAISE) hash ^= zobrist_keys.amount[zobrist_amount_bucket(action.amount)];
+    }
+    return hash;
+}
+
+History blinds(const TableState& state) {
+    return {{state.sb_index, Action(RAISE, SMALLBLIND)}, {state.bb_index, Action(RAISE, BIGBLIND - SMALLBLIND)}};
+}
+
+}
+
+TEST(incremental_hash_matches_recompute) {
+    uint32_t seed = 12345;
+    auto next_random = [&seed](int bound) {
+        seed = seed * 1103515245 + 12345;
+        return int((seed >> 16) % bound);
+    };
+    for (int hand = 0; hand < 200; ++hand) {
+        int num_players = 2 + hand % (MAXPLAYERS - 1);
+        TableState state = new_hand(num_players, 10 + next_random(INITIALSTACK));
+        History history = blinds(state);
+        CHECK_EQ(state.hash, full_hash(state, history));
+        int next_card = 2 * MAXPLAYERS;
+        while (!state.game_end()) {
+            if (state.betting_over()) {
+                state.next_round();
+                for (int dealt = state.round == FLOP ? 3 : 1; dealt > 0; --dealt) state.deal_to_board(Card::from_index(next_card++));
+            } else {
+                vector<Action> actions = candidate_actions(state);
+                Action action = actions[next_random(int(actions.size()))];
+                history.push_back({state.current_player_index, action});
+                CHECK_EQ(state.make_action(action), 0);
+            }
+            CHECK_EQ(state.hash, full_hash(state, history));
+        }
+    }
+}
+
+TEST(hash_depends_on_cards_and_line_played) {
+    TableState first = new_hand(3);
+    TableState second = new_hand(3);
+    CHECK_EQ(first.hash, second.hash);
+    second.deal_hole_cards(0, Card::from_index(50), Card::from_index(51));
+    CHECK(first.hash != second.hash);
+
+    TableState called = new_hand(2);
+    TableState also_called = new_hand(2);
+    TableState raised = new_hand(2);
+    CHECK_EQ(called.make_action(Action(CALL, 0)), 0);
+    CHECK_EQ(also_called.make_action(Action(CALL, 0)), 0);
+    CHECK_EQ(raised.make_action(Action(RAISE, BIGBLIND)), 0);
+    CHECK_EQ(called.hash, also_called.hash);
+    CHECK(called.hash != raised.hash);
+}
@@ -0,0 +1,125 @@
+#include <cstdint>
+#include <vector>
+#include "check.hpp"
+#include "timerwheel.hpp"
+using namespace std;
+
+namespace {
+
+// A timer that records the tick it fired on
+struct RecordedTimer {
+    TimerNode node;
+    vector<uint64_t> fired;
+
+    explicit RecordedTimer(TimerWheel& wheel) {
+        node.callback = [this, &wheel] { fired.push_back(wheel.now()); };
+    }
+};
+
+}
+
+TEST(timer_fires_on_its_tick_across_level_boundaries) {
+    const uint64_t starts[] = {0, 200, 255, 65530, (uint64_t(1) << 24) - 3};
+    const uint64_t delays[] = {1, 2, 255, 256, 257, 511, 65535, 65536, 65537, 70000, uint64_t(1) << 24, (uint64_t(1) << 24) + 300};
+    for (uint64_t start : starts) {
+        for (uint64_t delay : delays) {
+            TimerWheel wheel(start);
+            RecordedTimer timer(wheel);
+            wheel.schedule(&timer.node, delay);
+            CHECK_EQ(timer.node.expiry, start + delay);
+
+            wheel.advance(start + delay - 1);
+            CHECK(timer.fired.empty());
+            CHECK(timer.node.armed());
+            wheel.advance(start + delay);
+            CHECK_EQ(timer.fired.size(), 1);
+            if (!timer.fired.empty()) CHECK_EQ(timer.fired[0], start + delay);
+            CHECK(!timer.node.armed());
+        }
+    }
+}
+
+TEST(many_timers_fire_once_in_order) {
+    uint32_t seed = 4242;
+    auto next_random = [&seed](uint32_t bound) {
+        seed = seed * 1103515245 + 12345;
+        return ((seed >> 8) ^ (seed << 7)) % bound;
+    };
+    TimerWheel wheel(next_random(1 << 20));
+    vector<uint64_t> fired;
+    vector<TimerNode> timers(2000);
+    for (TimerNode& timer : timers) {
+        timer.callback = [&fired, &wheel] { fired.push_back(wheel.now()); };
+        wheel.schedule(&timer, 1 + next_random(200000));
+    }
+    uint64_t last = 0;
+    for (const TimerNode& timer : timers) last = timer.expiry > last ? timer.expiry : last;
+
+    // Advance by uneven steps so that some land on a boundary and some jump over one
+    while (wheel.now() < last) wheel.advance(wheel.now() + 1 + next_random(3000));
+
+    CHECK_EQ(fired.size(), timers.size());
+    for (size_t i = 1; i < fired.size(); ++i) CHECK(fired[i - 1] <= fired[i]);
+    for (const TimerNode& timer : timers) CHECK(!timer.armed());
+}
+
+TEST(cancelled_timer_does_not_fire) {
+    TimerWheel wheel;
+    RecordedTimer cancelled(wheel);
+    RecordedTimer same_slot(wheel);
+    RecordedTimer canceller(wheel);
+    wheel.schedule(&cancelled.node, 300);
+    cancelled.node.cancel();
+    CHECK(!cancelled.node.armed());
+
+    // A callback can cancel a timer due on the same tick
+    wheel.schedule(&canceller.node, 70000);
+    wheel.schedule(&same_slot.node, 70000);
+    canceller.node.callback = [&] { same_slot.node.cancel(); };
+    wheel.advance(80000);
+    CHECK(cancelled.fired.empty());
+    CHECK(same_slot.fired.empty());
+}
+
+TEST(timer_can_rearm_from_its_callback) {
+    TimerWheel wheel(250);
+    RecordedTimer timer(wheel);
+    timer.node.callback = [&] {
+        timer.fired.push_back(wheel.now());
+        if (timer.fired.size() < 4) wheel.schedule(&timer.node, 100);
+    };
+    wheel.schedule(&timer.node, 100);
+    wheel.advance(1000);
+    CHECK_EQ(timer.fired.size(), 4);
+    for (size_t i = 0; i < timer.fired.size(); ++i) CHECK_EQ(timer.fired[i], 350 + 100 * i);
+
+    // Scheduling an armed timer moves it rather than arming it twice
+    timer.fired.clear();
+    timer.node.callback = [&] { timer.fired.push_back(wheel.now()); };
+    wheel.schedule(&timer.node, 500);
+    wheel.schedule(&timer.node, 10);
+    wheel.advance(2000);
+    CHECK_EQ(timer.fired.size(), 1);
+    if (!timer.fired.empty()) CHECK_EQ(timer.fired[0], 1010);
+}
+
+TEST(delays_outside_the_wheel_are_clamped) {
+    TimerWheel wheel(1000);
+    TimerNode soon;
+    TimerNode far;
+    wheel.schedule(&soon, 0);
+    CHECK_EQ(soon.expiry, 1001);
+    wheel.schedule(&far, uint64_t(1) << 40);
+    CHECK_EQ(far.expiry, 1000 + (uint64_t(1) << 32) - 1);
+}
+
+TEST(destroyed_wheel_leaves_timers_unarmed) {
+    TimerNode timer;
+    {
+        TimerWheel wheel;
+        wheel.schedule(&timer, 1000);
+        CHECK(timer.armed());
+    }
+    CHECK(!timer.armed());
+    timer.cancel();
+}
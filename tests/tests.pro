@@ -0,0 +1,30 @@
+TEMPLATE = app
+CONFIG += console c++17 testcase
+CONFIG -= qt app_bundle
+
+TARGET = tests
+
+# Tests for the game code that builds without Qt, run them with make check
+
+SERVER_DIR = ../server
+
+INCLUDEPATH += $$SERVER_DIR
+
+SOURCES += \
+    main.cpp \
+    test_tablestate.cpp \
+    test_pots.cpp \
+    test_timerwheel.cpp \
+    $$SERVER_DIR/tablestate.cpp \
+    $$SERVER_DIR/cards.cpp \
+    $$SERVER_DIR/zobrist.cpp \
+    $$SERVER_DIR/pots.cpp \
+    $$SERVER_DIR/timerwheel.cpp
+
+HEADERS += \
+    check.hpp \
+    $$SERVER_DIR/tablestate.hpp \
+    $$SERVER_DIR/cards.hpp \
+    $$SERVER_DIR/zobrist.hpp \
+    $$SERVER_DIR/pots.hpp \
+    $$SERVER_DIR/timerwheel.hpp